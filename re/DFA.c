@@ -1,5 +1,7 @@
 
  #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
  #include <ncurses.h>
 
 
@@ -27,6 +29,29 @@
  char inpt[100]; // input string, with #. attached as end symbols.
  void follow(node *);
 
+ // growable stack of tree nodes, replaces the call stack in traversals
+ typedef struct
+ {
+   node **items;
+   int top;
+   int cap;
+ }node_stack;
+
+ void push(node_stack *st,node *n)
+ {
+   if(st->top==st->cap)
+   {
+     st->cap=st->cap?2*st->cap:64;
+     st->items=(node **)realloc(st->items,st->cap*sizeof(node *));
+   }
+   st->items[st->top++]=n;
+ }
+
+ node* pop(node_stack *st)
+ {
+   return st->items[--st->top];
+ }
+
  node* alloc(char ch)
  {
    node * temp;
@@ -62,68 +87,117 @@
    }
  }
 
- void print_nullable(node *root)
+ // post-order array of the tree, children before parents.
+ // returns the node count, caller frees *out.
+ int postorder(node *root,node ***out)
  {
+   node_stack st={NULL,0,0};
+   node_stack order={NULL,0,0};
    if(root!=NULL)
+     push(&st,root);
+   while(st.top>0)   // (node, right, left) order, reversed below
+   {
+     node *n=pop(&st);
+     push(&order,n);
+     if(n->lc!=NULL)
+       push(&st,n->lc);
+     if(n->rc!=NULL)
+       push(&st,n->rc);
+   }
+   free(st.items);
+   int i;
+   for(i=0;i<order.top/2;++i)
+   {
+     node *t=order.items[i];
+     order.items[i]=order.items[order.top-1-i];
+     order.items[order.top-1-i]=t;
+   }
+   *out=order.items;
+   return order.top;
+ }
+
+ void print_nullable(node *root)
+ {
+   node **order;
+   int n=postorder(root,&order);
+   int k;
+   for(k=0;k<n;++k)
    {
-     print_nullable(root->lc);
-     print_nullable(root->rc);
-     printf("%c\t",root->ch);
+     node *cur=order[k];
+     printf("%c\t",cur->ch);
      int i=0;
-     while(root->fpos[i]!=-1)
+     while(cur->fpos[i]!=-1)
      {
-       printf("%d ",root->fpos[i]);
+       printf("%d ",cur->fpos[i]);
        i++;
      }
      printf("\t");
      i=0;
-     while(root->lpos[i]!=-1)
+     while(cur->lpos[i]!=-1)
      {
-       printf("%d ",root->lpos[i]);
+       printf("%d ",cur->lpos[i]);
        i++;
      }
      printf("\n");
    }
+   free(order);
  }
 
 // create null information for nodes
+// str[0..*l] is postfix: operands are pushed, operators pop their children.
  node * create(char str[],int *l)
  {
-   node * nw;
-   nw=alloc(str[*l]);
-   if(str[*l]=='*'||str[*l]=='|'||str[*l]=='.')
+   node_stack st={NULL,0,0};
+   int i;
+   for(i=0;i<=*l;++i)
    {
-     if(str[*l]!='*')
+     node * nw;
+     nw=alloc(str[i]);
+     if(str[i]=='*'||str[i]=='|'||str[i]=='.')
      {
-       (*l)--;
-       nw->nullable=0;
-       nw->rc=create(str,l); //parse from end to begin, create right child firstly.
+       if(str[i]!='*')
+       {
+         nw->nullable=0;
+         nw->rc=pop(&st); // right child was pushed last
+       }
+       nw->lc=pop(&st); //only left child for star
      }
-     (*l)--;
-     nw->lc=create(str,l); //only left child for star
+     else
+       nw->nullable=0; // is a character
+     push(&st,nw);
    }
-   else
-     nw->nullable=0; // is a character
-   return nw;
+   *l=-1;
+   node *root=pop(&st);
+   free(st.items);
+   return root;
  }
 
  void inorder(node *root)
  {
-   if(root!=NULL)
+   node_stack st={NULL,0,0};
+   while(root!=NULL || st.top>0)
    {
-     inorder(root->lc);
+     while(root!=NULL)
+     {
+       push(&st,root);
+       root=root->lc;
+     }
+     root=pop(&st);
      printf("%c",root->ch);
-     inorder(root->rc);
+     root=root->rc;
    }
+   free(st.items);
  }
 
-// create firstpos and lastpos
- void create_nullable(node * root,int *pos)
+// create firstpos and lastpos, children are visited before their parents
+ void create_nullable(node * tree,int *pos)
  {
-   if(root->lc!=NULL)
-     create_nullable(root->lc,pos);
-   if(root->rc!=NULL)
-     create_nullable(root->rc,pos);
+   node **order;
+   int n=postorder(tree,&order);
+   int k;
+   for(k=0;k<n;++k)
+   {
+   node *root=order[k];
    if(root->lc==NULL && root->rc==NULL) // character
    {
      root->pos=(*pos); // position
@@ -164,6 +238,8 @@
      }
      follow(root); // create followpos
    }
+   }
+   free(order);
  }
 
 // create followpos
@@ -226,10 +302,54 @@
 
  int state[10][10];
 
+ // set of positions with O(1) insert, lookup and clear (dense + sparse
+ // index); keeps insertion order, like unio()
+ typedef struct
+ {
+   int dense[100];
+   int sparse[100];
+   int n;
+ }sparse_set;
+
+ void sset_clear(sparse_set *s)
+ {
+   s->n=0;
+ }
+
+ int sset_contains(sparse_set *s,int v)
+ {
+   int i=s->sparse[v];
+   return i>=0 && i<s->n && s->dense[i]==v;
+ }
+
+ void sset_insert(sparse_set *s,int v)
+ {
+   if(sset_contains(s,v))
+     return;
+   s->sparse[v]=s->n;
+   s->dense[s->n++]=v;
+ }
+
+ // add a -1 terminated list
+ void sset_add(sparse_set *s,int arr[])
+ {
+   int i;
+   for(i=0;arr[i]!=-1;++i)
+     sset_insert(s,arr[i]);
+ }
+
+ // copy out as a -1 terminated list
+ void sset_copy(sparse_set *s,int arr[])
+ {
+   memcpy(arr,s->dense,s->n*sizeof(int));
+   arr[s->n]=-1;
+ }
+
  void dfa()
  {
    int j=0,k=0,temp[10];
-   temp[0]=-1;
+   sparse_set next;
+   sset_clear(&next);
    int nos=1;
    int i;
    for(i=0;i<10;++i)
@@ -243,16 +363,17 @@
        for(j=0;state[k][j]!=-1;++j)
        {
          if(folltab[state[k][j]].ch==inpt[i])
-           { unio(temp,folltab[state[k][j]].follpos);  }
+           sset_add(&next,folltab[state[k][j]].follpos);
        }
+       sset_copy(&next,temp);
        m=check(temp,nos);
        if(m==-1)
        {
-          unio(state[nos++],temp);
+          sset_copy(&next,state[nos++]);
           m=nos-1;
        }
        dfaa[df++]=m;
-       temp[0]=-1;
+       sset_clear(&next);
      }
      if(k==nos-1)
        break;
@@ -0,0 +1,290 @@
+#ifndef REGEX_BYTECODE
+#define REGEX_BYTECODE
+
+#include <bitset>
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Opcodes of the typed postfix form. Leaves push a fragment, operators pop
+ * their operands' fragments and push the combined one.
+ */
+
+enum OpCode
+{
+    OP_LITERAL,  // operand: the character
+    OP_CLASS,    // operand: index into Bytecode::classes
+    OP_ANY,
+    OP_END,      // end marker, the '#' of the string form
+    OP_CONCAT,
+    OP_ALT,
+    OP_STAR,
+    OP_PLUS,
+    OP_OPTIONAL
+};
+
+struct Instruction
+{
+    OpCode op;
+    int operand;
+};
+
+typedef bitset<256> CharClass;
+
+/**
+ * Postfix instruction stream with its operands inline. Unlike the postfix
+ * string, a literal '.', a bracket expression and the end marker can't be
+ * confused, and nothing has to be looked up on the side.
+ */
+
+struct Bytecode
+{
+    vector<Instruction> code;
+    vector<CharClass> classes;   // bracket expressions, by class id
+    vector<string> classText;    // their source text, for display
+
+    static void printable(ostream& os, string const& text)
+    {
+        for (int i = 0; i < text.length(); i++)
+        {
+            unsigned char c = text[i];
+            if (c < 0x20 || c >= 0x7f)
+                os << "\\x" << hex << (c >> 4) << (c & 15) << dec;
+            else
+                os << c;
+        }
+    }
+
+    string disassemble() const
+    {
+        ostringstream os;
+        for (int i = 0; i < code.size(); i++)
+        {
+            if (i) os << ' ';
+            switch (code[i].op)
+            {
+                case OP_LITERAL:  os << "lit '"; printable(os, string(1, char(code[i].operand))); os << "'"; break;
+                case OP_CLASS:    os << "class "; printable(os, classText[code[i].operand]); break;
+                case OP_ANY:      os << "any"; break;
+                case OP_END:      os << "end"; break;
+                case OP_CONCAT:   os << "cat"; break;
+                case OP_ALT:      os << "alt"; break;
+                case OP_STAR:     os << "star"; break;
+                case OP_PLUS:     os << "plus"; break;
+                case OP_OPTIONAL: os << "opt"; break;
+            }
+        }
+        return os.str();
+    }
+};
+
+/**
+ * Stack machine that executes a Bytecode into a position automaton
+ * (nullable/firstpos/lastpos/followpos, as in re/DFA.c) and turns that into
+ * a DFA by subset construction. No syntax tree is built on the way.
+ */
+
+class PostfixVM
+{
+  private:
+
+    struct fragment
+    {
+        bool nullable;
+        set<int> first, last;
+    };
+
+    vector<CharClass> positions;  // what each position matches
+    vector<set<int> > followpos;
+    set<int> start;
+    int accept;                   // the position of OP_END, -1 if none
+
+    vector<vector<int> > transitions; // [state][byte], -1 is dead
+    vector<bool> accepting;
+
+    int leaf(stack<fragment>& frames, CharClass const& chars)
+    {
+        int p = positions.size();
+        positions.push_back(chars);
+        followpos.push_back(set<int>());
+
+        fragment f;
+        f.nullable = false;
+        f.first.insert(p);
+        f.last.insert(p);
+        frames.push(f);
+        return p;
+    }
+
+    void follow(set<int> const& from, set<int> const& to)
+    {
+        for (set<int>::const_iterator i = from.begin(); i != from.end(); ++i)
+            followpos[*i].insert(to.begin(), to.end());
+    }
+
+  public:
+
+    PostfixVM() : accept(-1) {}
+
+    int positionCount() const { return positions.size(); }
+    int stateCount() const { return transitions.size(); }
+
+    /**
+     * Execute the bytecode. Returns false if it is malformed (an operator
+     * without enough operands, or not exactly one result left).
+     */
+
+    bool run(Bytecode const& bc)
+    {
+        positions.clear();
+        followpos.clear();
+        start.clear();
+        accept = -1;
+
+        stack<fragment> frames;
+
+        for (int i = 0; i < bc.code.size(); i++)
+        {
+            Instruction const& in = bc.code[i];
+            CharClass chars;
+
+            switch (in.op)
+            {
+                case OP_LITERAL:
+                    chars.set((unsigned char)in.operand);
+                    leaf(frames, chars);
+                    break;
+
+                case OP_CLASS:
+                    leaf(frames, bc.classes[in.operand]);
+                    break;
+
+                case OP_ANY:
+                    chars.set();
+                    chars.reset('\n');
+                    leaf(frames, chars);
+                    break;
+
+                case OP_END:
+                    accept = leaf(frames, chars); // matches no byte
+                    break;
+
+                case OP_CONCAT:
+                case OP_ALT:
+                {
+                    if (frames.size() < 2)
+                        return false;
+                    fragment b = frames.top(); frames.pop();
+                    fragment a = frames.top(); frames.pop();
+                    fragment r;
+
+                    if (in.op == OP_CONCAT)
+                    {
+                        follow(a.last, b.first);
+                        r.nullable = a.nullable && b.nullable;
+                        r.first = a.first;
+                        if (a.nullable) r.first.insert(b.first.begin(), b.first.end());
+                        r.last = b.last;
+                        if (b.nullable) r.last.insert(a.last.begin(), a.last.end());
+                    }
+                    else
+                    {
+                        r.nullable = a.nullable || b.nullable;
+                        r.first = a.first;
+                        r.first.insert(b.first.begin(), b.first.end());
+                        r.last = a.last;
+                        r.last.insert(b.last.begin(), b.last.end());
+                    }
+                    frames.push(r);
+                    break;
+                }
+
+                case OP_STAR:
+                case OP_PLUS:
+                case OP_OPTIONAL:
+                {
+                    if (frames.empty())
+                        return false;
+                    fragment& a = frames.top();
+                    if (in.op != OP_OPTIONAL)
+                        follow(a.last, a.first);
+                    if (in.op != OP_PLUS)
+                        a.nullable = true;
+                    break;
+                }
+            }
+        }
+
+        if (frames.size() != 1)
+            return false;
+
+        start = frames.top().first;
+        buildDFA();
+        return true;
+    }
+
+    /**
+     * Subset construction over the positions; state 0 is the start state.
+     */
+
+    void buildDFA()
+    {
+        transitions.clear();
+        accepting.clear();
+
+        map<set<int>, int> ids;
+        vector<set<int> > states;
+
+        ids[start] = 0;
+        states.push_back(start);
+
+        for (int s = 0; s < states.size(); s++)
+        {
+            transitions.push_back(vector<int>(256, -1));
+            accepting.push_back(states[s].count(accept) > 0);
+
+            for (int c = 0; c < 256; c++)
+            {
+                set<int> next;
+                for (set<int>::const_iterator p = states[s].begin(); p != states[s].end(); ++p)
+                    if (positions[*p].test(c))
+                        next.insert(followpos[*p].begin(), followpos[*p].end());
+
+                if (next.empty())
+                    continue;
+
+                map<set<int>, int>::iterator found = ids.find(next);
+                if (found == ids.end())
+                {
+                    found = ids.insert(make_pair(next, (int)states.size())).first;
+                    states.push_back(next);
+                }
+                transitions[s][c] = found->second;
+            }
+        }
+    }
+
+    /**
+     * Whether the whole text matches.
+     */
+
+    bool match(string const& text) const
+    {
+        if (transitions.empty())
+            return false;
+
+        int s = 0;
+        for (int i = 0; i < text.length() && s >= 0; i++)
+            s = transitions[s][(unsigned char)text[i]];
+
+        return s >= 0 && accepting[s];
+    }
+};
+
+#endif // REGEX_BYTECODE
@@ -6,6 +6,8 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include "RegExBytecode.cpp"
 
 #define null 0
 #define OP_LEN 4
@@ -56,6 +58,53 @@ class RegExTree
 	return (it ==  precedenceMap.end())? 6 : precedenceMap.at(c);
     }
 
+    /**
+     * Parse the inside of a bracket expression ("^a-z0" for "[^a-z0]").
+     */
+
+    static CharClass parseClass(string body)
+    {
+        CharClass chars;
+        bool negated = !body.empty() && body[0] == '^';
+
+        for (int i = negated? 1 : 0; i < body.length(); i++)
+        {
+            unsigned char from = body[i], till = from;
+            if (i + 2 < body.length() && body[i + 1] == '-')
+            {
+                till = body[i + 2];
+                i += 2;
+            }
+            for (int c = from; c <= till; c++)
+                chars.set(c);
+        }
+
+        return negated? ~chars : chars;
+    }
+
+    static void emitOperator(Bytecode& bc, char c)
+    {
+        Instruction in = { OP_CONCAT, 0 };
+        switch (c)
+        {
+            case '|': in.op = OP_ALT; break;
+            case '*': in.op = OP_STAR; break;
+            case '+': in.op = OP_PLUS; break;
+            case '?': in.op = OP_OPTIONAL; break;
+        }
+        bc.code.push_back(in);
+    }
+
+    void pushOperator(stack<char>& ops, char c, Bytecode& bc)
+    {
+        while (!ops.empty() && ops.top() != '(' && getPrecedence(ops.top()) >= getPrecedence(c))
+        {
+            emitOperator(bc, ops.top());
+            ops.pop();
+        }
+        ops.push(c);
+    }
+
   public:
 
     RegExTree(string re)
@@ -147,27 +196,44 @@ class RegExTree
 		return res;
 	  }
 
+    /**
+     * Emit nodes and edges in pre-order. Uses an explicit stack of
+     * (node, next child) frames so deep trees don't exhaust the call stack.
+     */
+
     void dot(node* root)
     {
-        string tmp = root->ch;
+        stack<pair<node*, bool> > frames; // second: left child already done
+        frames.push(make_pair(root, false));
 
-        if (root->lc)
+        while (!frames.empty())
         {
-            os << root->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
-            os << root->name << " -> " << root->lc->name << "\n";
-            dot(root->lc);
-        }
+            node* n = frames.top().first;
+            bool left_done = frames.top().second;
+            frames.pop();
 
-        if (root->rc)
-        {
-            os << root->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
-            os << root->name << " -> " << root->rc->name << "\n";
-            dot(root->rc);
-        }
-        else
-        {
-            os << root->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
-            //os << *(root->ch) << "\n";
+            string tmp = n->ch;
+
+            if (!left_done && n->lc)
+            {
+                os << n->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
+                os << n->name << " -> " << n->lc->name << "\n";
+                frames.push(make_pair(n, true));
+                frames.push(make_pair(n->lc, false));
+                continue;
+            }
+
+            if (n->rc)
+            {
+                os << n->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
+                os << n->name << " -> " << n->rc->name << "\n";
+                frames.push(make_pair(n->rc, false));
+            }
+            else
+            {
+                os << n->name << "[fontname=\"Courier\",label=\"" << tmp << "\",shape=\"Mrecord\",]" << "\n";
+                //os << *(n->ch) << "\n";
+            }
         }
     }
 
@@ -261,6 +327,109 @@ class RegExTree
 		return postfix;
 	}
 
+    /**
+     * Same conversion as formatRegEx() + infixToPostfix(), but into typed
+     * instructions with their operands inline: no '.' placeholder and no
+     * side queue of bracket texts to keep in step.
+     *
+     * @param regex infix notation
+     * @return postfix instructions, ending in "end cat"
+     */
+
+    Bytecode infixToBytecode(string Regex)
+    {
+        Bytecode bc;
+
+        // operators and parentheses keep their char, operands are tagged 0
+        vector<pair<char, Instruction> > tokens;
+        for (int i = 0; i < Regex.length(); i++)
+        {
+            char c = Regex[i];
+            Instruction in = { OP_LITERAL, (unsigned char)c };
+
+            switch (c)
+            {
+                case '(': case ')':
+                case '|': case '?': case '+': case '*':
+                    tokens.push_back(make_pair(c, in));
+                    continue;
+
+                case '.':
+                    in.op = OP_ANY;
+                    break;
+
+                case '[':
+                {
+                    int l = 1;
+                    while (i + l < Regex.length() && Regex[i + l] != ']')
+                        l++;
+
+                    in.op = OP_CLASS;
+                    in.operand = bc.classes.size();
+                    bc.classText.push_back(Regex.substr(i, l + 1));
+                    bc.classes.push_back(parseClass(Regex.substr(i + 1, l - 1)));
+                    i += l;
+                    break;
+                }
+            }
+            tokens.push_back(make_pair(char(0), in));
+        }
+
+        stack<char> ops;
+        for (int i = 0; i < tokens.size(); i++)
+        {
+            char c = tokens[i].first;
+
+            // explicit concatenation, where formatRegEx() would put a '&'
+            if (i > 0)
+            {
+                char p = tokens[i - 1].first;
+                if (p != '(' && p != '|' && c != ')' && c != '|' && c != '?' && c != '+' && c != '*')
+                    pushOperator(ops, '&', bc);
+            }
+
+            switch (c)
+            {
+                case 0:
+                    bc.code.push_back(tokens[i].second);
+                    break;
+
+                case '(':
+                    ops.push(c);
+                    break;
+
+                case ')':
+                    while (!ops.empty() && ops.top() != '(')
+                    {
+                        emitOperator(bc, ops.top());
+                        ops.pop();
+                    }
+                    if (!ops.empty())
+                        ops.pop();
+                    break;
+
+                default:
+                    pushOperator(ops, c, bc);
+                    break;
+            }
+        }
+
+        while (!ops.empty())
+        {
+            emitOperator(bc, ops.top());
+            ops.pop();
+        }
+
+        // the end marker follows the whole expression, not its last branch
+        Instruction end = { OP_END, 0 };
+        bool empty = bc.code.empty();
+        bc.code.push_back(end);
+        if (!empty)
+            emitOperator(bc, '&');
+
+        return bc;
+    }
+
     void ReParseTree(string re)
     {
         //string re = r;
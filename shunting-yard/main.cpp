@@ -24,5 +24,16 @@ int main()
 
     t.ReParseTree(r);
 
+    // the same pattern as typed bytecode, straight into an automaton
+    Bytecode bc = t.infixToBytecode(re);
+    cout << bc.disassemble() << "\n";
+
+    PostfixVM vm;
+    if (vm.run(bc))
+    {
+        cout << vm.positionCount() << " positions, " << vm.stateCount() << " states\n";
+        cout << "match \"asc\\n(x)\": " << vm.match("asc\n(x)") << "\n";
+    }
+
     //cout << r << "\n";
 }
@@ -0,0 +1,288 @@
+#include "aho_corasick.hpp"
+#include "simd.hpp"
+#include <algorithm>
+
+namespace aho_corasick
+{
+    unsigned const automaton::root;
+
+    namespace
+    {
+        using strings = std::vector<std::string>;
+
+        // expands a subtree into `out`; false if it isn't a literal set
+        struct expander : boost::static_visitor<bool>
+        {
+            size_t  limit;
+            strings& out;
+
+            expander(size_t limit, strings& out) : limit(limit), out(out) {}
+
+            bool operator()(ast::alternative const& v) const {
+                strings all;
+                for (auto& branch : v)
+                {
+                    strings one;
+                    if (!expander(limit, one)(branch))
+                        return false;
+                    all.insert(all.end(), one.begin(), one.end());
+                    if (all.size() > limit)
+                        return false;
+                }
+                out.swap(all);
+                return true;
+            }
+
+            bool operator()(ast::sequence const& v) const {
+                strings product { std::string() };
+                for (auto& atom : v)
+                {
+                    strings tails;
+                    if (!(*this)(atom, tails))
+                        return false;
+                    if (product.size() * tails.size() > limit)
+                        return false;
+
+                    strings longer;
+                    for (auto& head : product)
+                        for (auto& tail : tails)
+                            longer.push_back(head + tail);
+                    product.swap(longer);
+                }
+                out.swap(product);
+                return true;
+            }
+
+            bool operator()(ast::atom const& v) const {
+                return (*this)(v, out);
+            }
+
+            bool operator()(ast::atom const& v, strings& into) const {
+                if (v.mult.minoccurs != 1 || v.mult.repeating())
+                    return false;
+                if (auto literal = boost::get<std::string>(&v.expr))
+                {
+                    into.assign(1, *literal);
+                    return true;
+                }
+                if (auto group = boost::get<ast::group>(&v.expr))
+                    return expander(limit, into)(group->root);
+                return false;
+            }
+        };
+    }
+
+    boost::optional<std::vector<std::string>> literals(ast::regex const& tree, size_t limit)
+    {
+        strings out;
+        if (!boost::apply_visitor(expander(limit, out), tree))
+            return boost::none;
+        for (auto& s : out)
+            if (s.empty())
+                return boost::none;
+        return out;
+    }
+
+    automaton build(std::vector<std::string> const& keywords)
+    {
+        automaton out;
+
+        out.classes.fill(0);
+        out.nclasses = 1;
+        for (auto& k : keywords)
+            for (unsigned char ch : k)
+                if (!out.classes[ch])
+                    out.classes[ch] = out.nclasses++;
+
+        // the trie; 0 is "no edge" while building, as no edge leads to root
+        std::vector<int> terminal;
+        auto add_state = [&](unsigned depth) {
+            out.next.resize(out.next.size() + out.nclasses, automaton::root);
+            out.depth.push_back(depth);
+            terminal.push_back(-1);
+            return unsigned(out.depth.size() - 1);
+        };
+        add_state(0);
+
+        for (unsigned id = 0; id < keywords.size(); ++id)
+        {
+            unsigned state = automaton::root;
+            for (unsigned char ch : keywords[id])
+            {
+                size_t const edge = state * out.nclasses + out.classes[ch];
+                if (out.next[edge] == automaton::root)
+                {
+                    unsigned const child = add_state(out.depth[state] + 1);
+                    out.next[edge] = child;
+                }
+                state = out.next[edge];
+            }
+            if (terminal[state] < 0) // the first of equal keywords wins
+                terminal[state] = id;
+            out.lengths.push_back(keywords[id].size());
+        }
+
+        // breadth first, so a state's failure target (shallower) already has
+        // its row completed and its match known
+        std::vector<unsigned> fail(out.size(), automaton::root), todo;
+        out.match.assign(out.size(), -1);
+        todo.push_back(automaton::root);
+        for (size_t i = 0; i < todo.size(); ++i)
+        {
+            unsigned const s = todo[i];
+            for (unsigned c = 0; c < out.nclasses; ++c)
+            {
+                unsigned& t = out.next[s * out.nclasses + c];
+                unsigned const fallback = s == automaton::root? automaton::root : out.next[fail[s] * out.nclasses + c];
+                if (t == automaton::root)
+                {
+                    t = fallback;
+                    continue;
+                }
+                fail[t] = fallback;
+                out.match[t] = terminal[t] >= 0? terminal[t] : out.match[fail[t]];
+                todo.push_back(t);
+            }
+        }
+
+        std::string first;
+        for (auto& k : keywords)
+            if (first.find(k[0]) == std::string::npos)
+                first += k[0];
+        if (first.size() <= 8)
+            out.first_bytes = first;
+        return out;
+    }
+
+    matcher::matcher(std::vector<std::string> const& list)
+    {
+        stats::stopwatch timer;
+        keywords = build(list);
+        compiled.time.determinize = timer.lap();
+
+        compiled.states      = keywords.size();
+        compiled.classes     = keywords.nclasses;
+        compiled.transitions = keywords.next.size();
+        compiled.table_bytes = keywords.next.size() * sizeof(keywords.next[0])
+                             + keywords.depth.size() * sizeof(keywords.depth[0])
+                             + keywords.match.size() * sizeof(keywords.match[0])
+                             + keywords.lengths.size() * sizeof(keywords.lengths[0])
+                             + sizeof(keywords.classes);
+
+        hits = profile::recorder(keywords.size(), keywords.nclasses);
+    }
+
+    namespace
+    {
+        // runs from `state` at `p` until a state that reports a keyword, or
+        // the end; skips to the next possible first byte while at the root
+        unsigned until_match(automaton const& a, profile::probe& hits, unsigned state, char const*& p, char const* end)
+        {
+            std::string const& skip = a.first_bytes;
+            int const* match = a.match.data();
+            unsigned const* next = a.next.data();
+            unsigned const nclasses = a.nclasses;
+
+            if (skip.empty())
+            {
+                while (match[state] < 0 && p != end)
+                {
+                    unsigned char const c = a.classes[static_cast<unsigned char>(*p++)];
+                    hits.step(state, c);
+                    state = next[state * nclasses + c];
+                }
+                return state;
+            }
+
+            while (match[state] < 0 && p != end)
+            {
+                if (state == automaton::root)
+                {
+                    hits.restart();
+                    p = util::find_any(p, end, skip.data(), skip.size());
+                    if (p == end)
+                        break;
+                    hits.candidate();
+                }
+                unsigned char const c = a.classes[static_cast<unsigned char>(*p++)];
+                hits.step(state, c);
+                state = next[state * nclasses + c];
+            }
+            if (match[state] >= 0)
+                hits.matched();
+            return state;
+        }
+    }
+
+    boost::optional<dfa::span> matcher::find(char const* begin, char const* end, char const* from, stats::scan* counters) const
+    {
+        automaton const& a = keywords;
+        profile::probe probe(hits);
+        char const* p = from;
+        unsigned state = until_match(a, probe, automaton::root, p, end);
+
+        // a match seen later can still start earlier (`c` ends before `abcd`
+        // in `abcd|c`), but never before the prefix the state stands for
+        int best = -1;
+        size_t best_begin = 0;
+        for (;; ++p)
+        {
+            int const id = a.match[state];
+            if (id >= 0)
+            {
+                size_t const start = p - begin - a.lengths[id];
+                if (best < 0 || start < best_begin || (start == best_begin && id < best))
+                {
+                    best = id;
+                    best_begin = start;
+                }
+            }
+            if (best < 0 || size_t(p - begin) - a.depth[state] > best_begin || p == end)
+                break;
+            unsigned char const c = a.classes[static_cast<unsigned char>(*p)];
+            probe.step(state, c);
+            state = a.next[state * a.nclasses + c];
+        }
+        if (counters)
+            counters->bytes += p - from;
+
+        if (best < 0)
+            return boost::none;
+        if (counters)
+            counters->matches += 1;
+        return dfa::span { best_begin, best_begin + a.lengths[best] };
+    }
+
+    boost::optional<dfa::span> matcher::find(std::string const& text, size_t from, stats::scan* counters) const
+    {
+        char const* begin = text.data();
+        return find(begin, begin + text.size(), begin + from, counters);
+    }
+
+    std::vector<dfa::span> matcher::find_all(std::string const& text, stats::scan* counters) const
+    {
+        std::vector<dfa::span> matches;
+        for (size_t from = 0; from <= text.size();)
+        {
+            auto m = find(text, from, counters);
+            if (!m)
+                break;
+            matches.push_back(*m);
+            from = m->end; // keywords are never empty
+        }
+        return matches;
+    }
+
+    bool matcher::search(char const* begin, char const* end, stats::scan* counters) const
+    {
+        profile::probe probe(hits);
+        char const* p = begin;
+        bool const found = keywords.match[until_match(keywords, probe, automaton::root, p, end)] >= 0;
+        if (counters)
+        {
+            counters->bytes += p - begin;
+            counters->matches += found;
+        }
+        return found;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef __AHO_CORASICK__
+#define __AHO_CORASICK__
+
+#include "ast.hpp"
+#include "dfa.hpp"
+#include "profile.hpp"
+#include "stats.hpp"
+#include <array>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace aho_corasick
+{
+    // The strings a pattern made of nothing but literals, groups and
+    // alternation matches, in match priority order: `(XYZ)|(123)` gives
+    // XYZ, 123 and `a(b|c)d` gives abd, acd. None when the pattern uses
+    // anything else (quantifiers, classes, anchors), can match the empty
+    // string, or expands to more than `limit` strings.
+    boost::optional<std::vector<std::string>> literals(ast::regex const& tree, size_t limit = 1 << 16);
+
+    // Keyword trie with the failure links folded into a complete transition
+    // table, so the scan takes one lookup per byte like the DFA. Bytes that
+    // occur in no keyword share class 0.
+    struct automaton
+    {
+        static unsigned const root = 0;
+
+        std::array<unsigned char, 256> classes;
+        unsigned                       nclasses;
+        std::vector<unsigned>          next;  // [state * nclasses + class]
+        std::vector<unsigned>          depth; // length of the prefix a state stands for
+
+        // the keyword to report when the scan is in this state: the longest
+        // one that ends here (it starts first), the lowest id among equals;
+        // -1 if none
+        std::vector<int>               match;
+        std::vector<unsigned>          lengths; // by keyword id
+
+        // the bytes keywords start with, when there are few enough to skip
+        // to with util::find_any while the scan is at the root; else empty
+        std::string                    first_bytes;
+
+        unsigned size() const { return depth.size(); }
+        unsigned step(unsigned state, unsigned char byte) const {
+            return next[state * nclasses + classes[byte]];
+        }
+    };
+
+    // keywords must not be empty
+    automaton build(std::vector<std::string> const& keywords);
+
+    // Leftmost-first search over a set of keywords, with the same results
+    // as dfa::matcher on the alternation they came from: the match that
+    // starts first, and of those the keyword listed first.
+    // In a -DDFA_PROFILE build the scans count their steps, and how often
+    // the first-byte skip stopped at a byte no keyword followed, into `hits`.
+    struct matcher
+    {
+        automaton         keywords;
+        stats::compile    compiled;
+        profile::recorder hits;
+
+        explicit matcher(std::vector<std::string> const& keywords);
+
+        boost::optional<dfa::span> find(char const* begin, char const* end, char const* from, stats::scan* counters = nullptr) const;
+        boost::optional<dfa::span> find(std::string const& text, size_t from = 0, stats::scan* counters = nullptr) const;
+        std::vector<dfa::span>     find_all(std::string const& text, stats::scan* counters = nullptr) const;
+
+        // whether [begin, end) contains any keyword; stops at the first one
+        bool search(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+    };
+}
+
+#endif // __AHO_CORASICK__
@@ -0,0 +1,260 @@
+#include "approx.hpp"
+#include "glushkov.hpp"
+#include <algorithm>
+
+namespace approx
+{
+    using glushkov::symbol_kind;
+
+    namespace
+    {
+        unsigned const bits = 64;
+
+        // Where `from` leads through zero-width positions: the byte
+        // positions reached (by bit) and whether '#' is. `^` is passed only
+        // if `at_begin`, `$` only if `at_end`, and nothing consumes a byte
+        // once a `$` is behind.
+        struct closure
+        {
+            glushkov::automaton const& fa;
+            std::vector<int> const&    bit; // by position, -1 if not a byte
+
+            std::vector<char> visited; // [position * 2 + past an end assertion]
+            std::vector<word> reached;
+            bool              accepts;
+
+            closure(glushkov::automaton const& fa, std::vector<int> const& bit, unsigned words)
+                : fa(fa), bit(bit), visited(2 * fa.positions.size()), reached(words), accepts(false)
+            { }
+
+            void walk(std::vector<unsigned> const& from, bool at_begin, bool at_end) {
+                std::fill(visited.begin(), visited.end(), 0);
+                std::fill(reached.begin(), reached.end(), 0);
+                accepts = false;
+                for (auto q : from)
+                    enter(q, false, at_begin, at_end);
+            }
+
+            void enter(unsigned p, bool ended, bool at_begin, bool at_end) {
+                if (visited[2 * p + ended])
+                    return;
+                visited[2 * p + ended] = 1;
+
+                switch (fa.positions[p].kind)
+                {
+                    case symbol_kind::byte:
+                        if (!ended)
+                            reached[bit[p] / bits] |= word(1) << bit[p] % bits;
+                        return;
+                    case symbol_kind::accept:
+                        accepts = true;
+                        return;
+                    case symbol_kind::begin_assert:
+                        if (!at_begin)
+                            return;
+                        break;
+                    case symbol_kind::end_assert:
+                        if (!at_end)
+                            return;
+                        ended = true;
+                        break;
+                    case symbol_kind::tag:
+                        break;
+                }
+                for (auto q : fa.follow[p])
+                    enter(q, ended, at_begin, at_end);
+            }
+        };
+
+        // the position sets of all error levels, one after the other
+        struct levels
+        {
+            unsigned          words;
+            std::vector<word> sets;
+
+            levels(unsigned k, unsigned words) : words(words), sets((k + 1) * words) { }
+
+            word*       operator[](unsigned i)       { return &sets[i * words]; }
+            word const* operator[](unsigned i) const { return &sets[i * words]; }
+        };
+
+        // out = the union of follow sets of the positions in `in`, | `also`
+        void follow_of(matcher const& m, word const* in, word const* also, word* out)
+        {
+            unsigned const words = m.words;
+            for (unsigned w = 0; w < words; ++w)
+                out[w] = also[w];
+            for (unsigned c = 0; c < m.chunks; ++c)
+            {
+                unsigned const v = in[c / 8] >> (c % 8 * 8) & 0xff;
+                if (v == 0)
+                    continue;
+                word const* row = &m.follow[(c * 256 + v) * words];
+                for (unsigned w = 0; w < words; ++w)
+                    out[w] |= row[w];
+            }
+        }
+
+        bool meets(word const* a, word const* b, unsigned words)
+        {
+            for (unsigned w = 0; w < words; ++w)
+                if (a[w] & b[w])
+                    return true;
+            return false;
+        }
+
+        // the lowest level with a match ending `offset` bytes into the text,
+        // or k + 1; the empty match needing `^` costs those bytes inserted
+        unsigned lowest(matcher const& m, levels const& r, size_t offset, bool at_end)
+        {
+            if (m.empty[0][at_end])
+                return 0;
+            unsigned const anchored = m.empty[1][at_end] && offset <= m.k? offset : m.k + 1;
+
+            word const* last = m.last[at_end].data();
+            for (unsigned i = 0; i < anchored; ++i)
+                if (meets(r[i], last, m.words))
+                    return i;
+            return anchored;
+        }
+
+        glushkov::options folded(bool icase)
+        {
+            glushkov::options opts;
+            opts.icase = icase;
+            return opts;
+        }
+    }
+
+    matcher::matcher(ast::regex const& tree, unsigned max_errors, bool icase)
+        : k(max_errors)
+    {
+        stats::stopwatch timer;
+        auto const fa = glushkov::build(tree, folded(icase));
+        compiled.time.positions = timer.lap();
+        compiled.positions = fa.positions.size();
+
+        std::vector<int> bit(fa.positions.size(), -1);
+        std::vector<unsigned> bytes; // by bit
+        for (unsigned p = 0; p < fa.positions.size(); ++p)
+            if (fa.positions[p].kind == symbol_kind::byte)
+            {
+                bit[p] = bytes.size();
+                bytes.push_back(p);
+            }
+        unsigned const n = bytes.size();
+        words  = n == 0? 1 : (n + bits - 1) / bits;
+        chunks = (n + 7) / 8;
+
+        chars.assign(256 * words, 0);
+        for (unsigned i = 0; i < n; ++i)
+        {
+            auto const& pos = fa.positions[bytes[i]];
+            for (unsigned b = 0; b < 256; ++b)
+                if (pos.chars.test(b))
+                    chars[b * words + i / bits] |= word(1) << i % bits;
+        }
+
+        closure reach(fa, bit, words);
+        for (bool at_begin : { false, true })
+        {
+            reach.walk(fa.first, at_begin, false);
+            first[at_begin] = reach.reached;
+            for (bool at_end : { false, true })
+            {
+                reach.walk(fa.first, at_begin, at_end);
+                empty[at_begin][at_end] = reach.accepts;
+            }
+        }
+
+        // row v of a chunk is row v without its highest bit, plus the
+        // follow set of the position that bit stands for
+        follow.assign(chunks * 256 * words, 0);
+        last[0].assign(words, 0);
+        last[1].assign(words, 0);
+        for (unsigned i = 0; i < n; ++i)
+        {
+            word const mask = word(1) << i % bits;
+            reach.walk(fa.follow[bytes[i]], false, true);
+            if (reach.accepts)
+                last[1][i / bits] |= mask;
+            reach.walk(fa.follow[bytes[i]], false, false);
+            if (reach.accepts)
+                last[0][i / bits] |= mask;
+
+            unsigned const c = i / 8, top = 1u << i % 8;
+            for (unsigned v = top; v < 2 * top; ++v)
+            {
+                word*       row  = &follow[(c * 256 + v) * words];
+                word const* rest = &follow[(c * 256 + (v & ~top)) * words];
+                for (unsigned w = 0; w < words; ++w)
+                    row[w] = rest[w] | reach.reached[w];
+            }
+        }
+        compiled.time.determinize = timer.lap();
+        compiled.table_bytes = (chars.size() + follow.size() + first[0].size() + first[1].size() + last[0].size() + last[1].size()) * sizeof(word);
+    }
+
+    // Level i after a byte: the positions it moves on to matching it, or
+    // those level i - 1 gets to by one edit: the byte inserted (stay), put
+    // in place of the next position (move on regardless of the byte), or a
+    // position skipped after it (move on without it). Every level also
+    // starts a fresh attempt at each byte, which is what makes it a search;
+    // past `^` only while all bytes so far can count as inserted.
+    boost::optional<matcher::hit> matcher::find(char const* begin, char const* end, stats::scan* counters) const
+    {
+        levels r(k, words), moved(k, words), next(k, words);
+        boost::optional<hit> found;
+
+        // before the first byte only deletions: position sets reached by
+        // skipping 1, 2, .. positions
+        for (unsigned i = 1; i <= k; ++i)
+            follow_of(*this, r[i - 1], first[1].data(), r[i]);
+
+        unsigned errors = lowest(*this, r, 0, begin == end);
+        if (errors <= k)
+            found = hit { 0, errors };
+
+        char const* p = begin;
+        for (; p != end && !found; ++p)
+        {
+            word const* accepting = &chars[static_cast<unsigned char>(*p) * words];
+            size_t const offset   = p - begin;
+
+            for (unsigned i = 0; i <= k; ++i)
+                follow_of(*this, r[i], first[offset <= i].data(), moved[i]);
+
+            for (unsigned w = 0; w < words; ++w)
+                next[0][w] = moved[0][w] & accepting[w];
+            for (unsigned i = 1; i <= k; ++i)
+            {
+                word* out = next[i];
+                follow_of(*this, next[i - 1], moved[i - 1], out);
+                for (unsigned w = 0; w < words; ++w)
+                    out[w] |= (moved[i][w] & accepting[w]) | r[i - 1][w];
+            }
+            std::swap(r.sets, next.sets);
+
+            errors = lowest(*this, r, offset + 1, p + 1 == end);
+            if (errors <= k)
+                found = hit { offset + 1, errors };
+        }
+
+        if (counters)
+        {
+            counters->bytes += p - begin;
+            counters->matches += bool(found);
+        }
+        return found;
+    }
+
+    bool matcher::search(char const* begin, char const* end, stats::scan* counters) const
+    {
+        return bool(find(begin, end, counters));
+    }
+
+    bool matcher::search(std::string const& text) const
+    {
+        return search(text.data(), text.data() + text.size());
+    }
+}
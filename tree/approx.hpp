@@ -0,0 +1,53 @@
+#ifndef __APPROX__
+#define __APPROX__
+
+#include "ast.hpp"
+#include "stats.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace approx
+{
+    using word = std::uint64_t;
+
+    // Search allowing up to `k` edits (a byte inserted, deleted or
+    // substituted, one each), Wu-Manber style over the glushkov positions.
+    // The byte positions are the bits of a word vector; error level i
+    // holds the positions a pattern prefix can have reached with i edits,
+    // so a byte costs a few word operations per level instead of one rule
+    // per misspelling. Follow sets are tabled eight positions at a time
+    // (Navarro-Raffinot), so the pattern need not be a plain string; up to
+    // 64 byte positions a level is one word.
+    //
+    // `^` and `$` hold at the text ends only and are never edited away.
+    struct matcher
+    {
+        struct hit
+        {
+            std::size_t end;    // offset just past the match
+            unsigned    errors; // fewest edits of a match ending there
+        };
+
+        unsigned          k;
+        unsigned          words;   // per position set
+        unsigned          chunks;  // of eight positions
+        std::vector<word> chars;   // [byte * words + w]: positions the byte may stand at
+        std::vector<word> follow;  // [(chunk * 256 + bits) * words + w]: union of the follow sets
+        std::vector<word> first[2]; // [at text start]
+        std::vector<word> last[2];  // positions a match may end with, [at text end]
+        bool              empty[2][2]; // the pattern matches "" (no edits), [at text start][at text end]
+        stats::compile    compiled;
+
+        matcher(ast::regex const& tree, unsigned max_errors, bool icase = false);
+
+        // where the first match ends, however early it starts
+        boost::optional<hit> find(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+
+        bool search(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+        bool search(std::string const& text) const;
+    };
+}
+
+#endif // __APPROX__
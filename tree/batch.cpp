@@ -0,0 +1,129 @@
+#include "batch.hpp"
+#include "simd.hpp"
+#include <algorithm>
+
+namespace batch
+{
+    std::vector<slice> lines(std::string const& text)
+    {
+        std::vector<slice> out;
+        char const* p   = text.data();
+        char const* end = p + text.size();
+        while (p != end)
+        {
+            char const* eol = util::find_byte(p, end, '\n');
+            out.push_back({ p, eol });
+            p = eol == end? eol : eol + 1;
+        }
+        return out;
+    }
+
+    std::vector<size_t> split(std::vector<slice> const& inputs, size_t batch_bytes)
+    {
+        std::vector<size_t> bounds { 0 };
+        size_t bytes = 0;
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            bytes += inputs[i].size() + 1; // an empty input still costs a search
+            if (bytes >= batch_bytes)
+            {
+                bounds.push_back(i + 1);
+                bytes = 0;
+            }
+        }
+        if (bounds.back() != inputs.size())
+            bounds.push_back(inputs.size());
+        return bounds;
+    }
+
+    pool::pool(unsigned workers) : remaining(0)
+    {
+        workers = std::max(workers, 1u);
+        for (unsigned i = 0; i < workers; ++i)
+            queues.emplace_back(new queue);
+        for (unsigned i = 0; i < workers; ++i)
+            threads.emplace_back(&pool::work, this, i);
+    }
+
+    pool::~pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void pool::run(size_t count, std::function<void(size_t)> const& job)
+    {
+        if (count == 0)
+            return;
+
+        // `remaining` and the queues belong to one run at a time
+        std::lock_guard<std::mutex> turn(running);
+        std::unique_lock<std::mutex> guard(lock);
+        remaining = count;
+
+        unsigned const n = queues.size();
+        for (unsigned w = 0; w < n; ++w)
+        {
+            std::lock_guard<std::mutex> q(queues[w]->lock);
+            for (size_t i = count * w / n; i < count * (w + 1) / n; ++i)
+                queues[w]->tasks.emplace_back(&job, i);
+        }
+        ++generation;
+        wake.notify_all();
+        done.wait(guard, [this] { return remaining == 0; });
+    }
+
+    bool pool::take(unsigned self, task& out)
+    {
+        unsigned const n = queues.size();
+        for (unsigned k = 0; k < n; ++k)
+        {
+            queue& q = *queues[(self + k) % n];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.tasks.empty())
+                continue;
+            if (k == 0)
+            {
+                out = q.tasks.front();
+                q.tasks.pop_front();
+            } else
+            {
+                out = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void pool::work(unsigned self)
+    {
+        unsigned long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            task next;
+            while (take(self, next))
+            {
+                (*next.first)(next.second);
+                if (--remaining == 0)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    done.notify_all();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef __BATCH__
+#define __BATCH__
+
+#include "slice.hpp"
+#include "stats.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace batch
+{
+    using util::slice;
+
+    std::vector<slice> lines(std::string const& text);
+
+    // Fixed set of worker threads with a task queue each. `run` deals the
+    // tasks out in contiguous blocks, one per worker; a worker takes from
+    // the front of its own queue and, once that is empty, steals from the
+    // back of the others, so a block of slow inputs doesn't leave the rest
+    // of the pool idle. The calling thread waits, it doesn't work.
+    class pool
+    {
+      public:
+        explicit pool(unsigned workers = std::thread::hardware_concurrency());
+        ~pool();
+
+        pool(pool const&) = delete;
+        pool& operator=(pool const&) = delete;
+
+        unsigned size() const { return threads.size(); }
+
+        // calls job(i) for every i in [0, count) and returns when all are
+        // done; a job must not throw. Calls from several threads take turns,
+        // each waiting for the one before it; a job must not call `run` on
+        // its own pool.
+        void run(size_t count, std::function<void(size_t)> const& job);
+
+      private:
+        // a task carries its job: a worker still draining the queues when
+        // the next `run` starts must not call the old one
+        using job_type = std::function<void(size_t)>;
+        using task     = std::pair<job_type const*, size_t>;
+
+        struct queue
+        {
+            std::mutex       lock;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::thread>            threads;
+        std::vector<std::unique_ptr<queue>> queues;
+
+        std::mutex                          running; // one `run` at a time
+        std::mutex                          lock;
+        std::condition_variable             wake, done;
+        unsigned long                       generation = 0;
+        std::atomic<size_t>                 remaining;
+        bool                                stopping = false;
+
+        bool take(unsigned self, task& out);
+        void work(unsigned self);
+    };
+
+    // Inputs are handed out in batches of consecutive slices of about this
+    // many bytes: enough to keep a worker's automaton tables warm between
+    // two trips to the queues, small enough to balance.
+    size_t const default_batch_bytes = 64 << 10;
+
+    // [first slice of batch i, first slice of batch i + 1), i.e. one more
+    // boundary than there are batches
+    std::vector<size_t> split(std::vector<slice> const& inputs, size_t batch_bytes = default_batch_bytes);
+
+    namespace detail
+    {
+        // engines that can search several inputs at once (dfa::matcher
+        // interleaves them) are handed the whole batch
+        template <typename Matcher>
+        auto search_each(Matcher const& m, slice const* inputs, size_t count, char* found, stats::scan* counters, int)
+            -> decltype(m.search(inputs, count, found, counters))
+        {
+            return m.search(inputs, count, found, counters);
+        }
+
+        template <typename Matcher>
+        void search_each(Matcher const& m, slice const* inputs, size_t count, char* found, stats::scan* counters, long)
+        {
+            for (size_t i = 0; i < count; ++i)
+                found[i] = m.search(inputs[i].begin, inputs[i].end, counters);
+        }
+    }
+
+    // Whether each input contains a match, in input order. It is a char per
+    // input rather than a packed bitmap, so no two workers write the same
+    // byte. `Matcher` is any engine with
+    // `bool search(char const*, char const*, stats::scan*) const`
+    // (dfa::matcher, nfa::matcher); it is shared by all workers, which only
+    // read it. `counters`, when given, accumulate over all inputs.
+    template <typename Matcher>
+    std::vector<char> matches(Matcher const& m, std::vector<slice> const& inputs, pool& workers,
+            stats::scan* counters = nullptr, size_t batch_bytes = default_batch_bytes)
+    {
+        std::vector<char> out(inputs.size());
+        auto const bounds = split(inputs, batch_bytes);
+        std::vector<stats::scan> scanned(counters? bounds.size() - 1 : 0);
+
+        workers.run(bounds.size() - 1, [&](size_t b) {
+            size_t const first = bounds[b];
+            detail::search_each(m, inputs.data() + first, bounds[b + 1] - first, out.data() + first,
+                    counters? &scanned[b] : nullptr, 0);
+        });
+
+        for (auto& s : scanned)
+            *counters += s;
+        return out;
+    }
+
+    // how many inputs contain a match
+    template <typename Matcher>
+    size_t count(Matcher const& m, std::vector<slice> const& inputs, pool& workers,
+            stats::scan* counters = nullptr, size_t batch_bytes = default_batch_bytes)
+    {
+        size_t total = 0;
+        for (auto found : matches(m, inputs, workers, counters, batch_bytes))
+            total += found;
+        return total;
+    }
+}
+
+#endif // __BATCH__
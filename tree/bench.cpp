@@ -0,0 +1,427 @@
+// Throughput comparison: the engines in this tree against std::regex and
+// boost::regex, over a fixed set of patterns and generated corpora.
+//
+// For every (pattern, engine) it reports compile time, scan speed and the
+// peak heap used while compiling and scanning. Two workloads:
+//  - "all":   every non-overlapping match in the whole buffer
+//  - "lines": which lines contain a match (one search per line)
+// "dfa batch" spreads the lines over a thread pool (batch::count), "dfa
+// lines" scans the whole buffer in line mode (dfa::matcher::count_lines),
+// "planned" lets planner::matcher pick the engine for the lines workload.
+#include "ast.hpp"
+#include "aho_corasick.hpp"
+#include "batch.hpp"
+#include "parser.hpp"
+#include "dfa.hpp"
+#include "nfa.hpp"
+#include "planner.hpp"
+#include "tdfa.hpp"
+#include "stats.hpp"
+#include <boost/regex.hpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <malloc.h>
+
+// heap accounting, so each engine's peak can be measured in isolation;
+// atomic because the pool's workers allocate too
+namespace
+{
+    std::atomic<size_t> heap_live(0), heap_peak(0);
+
+    void* counted_alloc(size_t n)
+    {
+        void* p = std::malloc(n? n : 1);
+        if (!p)
+            throw std::bad_alloc();
+        size_t const live = heap_live += malloc_usable_size(p);
+        size_t peak = heap_peak;
+        while (live > peak && !heap_peak.compare_exchange_weak(peak, live))
+            ;
+        return p;
+    }
+
+    void counted_free(void* p)
+    {
+        if (!p)
+            return;
+        heap_live -= malloc_usable_size(p);
+        std::free(p);
+    }
+}
+
+void* operator new(size_t n)                 { return counted_alloc(n); }
+void* operator new[](size_t n)               { return counted_alloc(n); }
+void  operator delete(void* p) noexcept      { counted_free(p); }
+void  operator delete[](void* p) noexcept    { counted_free(p); }
+void  operator delete(void* p, size_t) noexcept   { counted_free(p); }
+void  operator delete[](void* p, size_t) noexcept { counted_free(p); }
+
+namespace
+{
+    struct corpus
+    {
+        std::string name;
+        std::string text;
+    };
+
+    corpus log_corpus(size_t bytes)
+    {
+        static char const* const levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+        static char const* const users[]  = { "alice", "bob", "carol", "dave", "eve" };
+        std::mt19937 rng(42);
+        auto pick = [&rng](unsigned n) { return unsigned(rng() % n); };
+
+        corpus c { "log" };
+        char line[256];
+        while (c.text.size() < bytes)
+        {
+            unsigned const day = 1 + pick(28), h = pick(24), m = pick(60), s = pick(60);
+            char const* level  = levels[pick(6)];
+            unsigned const worker = pick(16), id = unsigned(rng());
+            char const* user   = users[pick(5)];
+            unsigned const status = pick(10)? 200 : 500 + pick(4), took = pick(1000);
+
+            std::snprintf(line, sizeof(line),
+                    "2014-10-%02u %02u:%02u:%02u %s [worker-%u] id=%08x user=%s@example.com status=%u (took %ums)\n",
+                    day, h, m, s, level, worker, id, user, status, took);
+            c.text += line;
+        }
+        return c;
+    }
+
+    corpus text_corpus(size_t bytes)
+    {
+        std::mt19937 rng(7);
+        static char const alphabet[] = "abcdefghijklmnopqrstuvwxyz XYZ123()\t";
+
+        corpus c { "text" };
+        while (c.text.size() < bytes)
+            c.text += (rng() % 80)? alphabet[rng() % (sizeof(alphabet) - 1)] : '\n';
+        return c;
+    }
+
+    // long runs that make backtracking engines explore every split
+    corpus runs_corpus(char ch, size_t run, size_t count)
+    {
+        corpus c { std::string("runs-of-") + ch };
+        for (size_t i = 0; i < count; ++i)
+            c.text += std::string(run, ch) + "\n";
+        return c;
+    }
+
+    // `count` random lowercase words of 4 to 8 letters, as one alternation
+    std::string keyword_pattern(unsigned count)
+    {
+        std::mt19937 rng(11);
+        std::string pattern;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (i)
+                pattern += '|';
+            for (unsigned n = 4 + rng() % 5; n > 0; --n)
+                pattern += char('a' + rng() % 26);
+        }
+        return pattern;
+    }
+
+    // one engine's view of a compiled pattern
+    struct engine
+    {
+        std::function<size_t(std::string const&)>        find_all;
+        std::function<bool(char const*, char const*)>    search;
+        // counts the matching lines at once instead of calling `search`
+        std::function<size_t(std::string const&, std::vector<batch::slice> const&)> count_lines;
+    };
+
+    struct compiler
+    {
+        char const* name;
+        // returns false when the engine doesn't support the pattern
+        std::function<bool(std::string const&, engine&)> compile;
+    };
+
+    std::vector<compiler> compilers()
+    {
+        std::vector<compiler> all;
+
+        all.push_back({ "dfa", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto m = std::make_shared<dfa::matcher>(tree);
+            e.find_all = [m](std::string const& text) { return m->find_all(text).size(); };
+            e.search   = [m](char const* b, char const* l) { return m->search(b, l); };
+            return true;
+        } });
+
+        all.push_back({ "dfa batch", [](std::string const& pattern, engine& e) {
+            static batch::pool workers;
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto m = std::make_shared<dfa::matcher>(tree);
+            e.count_lines = [m](std::string const&, std::vector<batch::slice> const& lines) { return batch::count(*m, lines, workers); };
+            return true;
+        } });
+
+        all.push_back({ "dfa lines", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto m = std::make_shared<dfa::matcher>(tree);
+            e.count_lines = [m](std::string const& text, std::vector<batch::slice> const&) { return m->count_lines(text); };
+            return true;
+        } });
+
+        all.push_back({ "aho-corasick", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto keywords = aho_corasick::literals(tree);
+            if (!keywords)
+                return false;
+            auto m = std::make_shared<aho_corasick::matcher>(*keywords);
+            e.find_all = [m](std::string const& text) { return m->find_all(text).size(); };
+            e.search   = [m](char const* b, char const* l) { return m->search(b, l); };
+            return true;
+        } });
+
+        all.push_back({ "planned", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            planner::options opts;
+            opts.wanted = planner::goal::search;
+            auto m = std::make_shared<planner::matcher>(tree, opts);
+            e.search = [m](char const* b, char const* l) { return m->search(b, l); };
+            return true;
+        } });
+
+        all.push_back({ "nfa", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto m = std::make_shared<nfa::matcher>(tree);
+            e.search = [m](char const* b, char const* l) { return m->search(b, l); };
+            return true;
+        } });
+
+        all.push_back({ "tdfa", [](std::string const& pattern, engine& e) {
+            ast::regex tree;
+            if (!doParse(pattern, tree))
+                return false;
+            auto m = std::make_shared<tdfa::matcher>(tree);
+            e.search = [m](char const* b, char const* l) {
+                tdfa::captures groups;
+                return m->find(b, l, b, groups);
+            };
+            return true;
+        } });
+
+        all.push_back({ "std::regex", [](std::string const& pattern, engine& e) {
+            try
+            {
+                auto r = std::make_shared<std::regex>(pattern);
+                e.find_all = [r](std::string const& text) {
+                    return size_t(std::distance(std::sregex_iterator(text.begin(), text.end(), *r), std::sregex_iterator()));
+                };
+                e.search = [r](char const* b, char const* l) { return std::regex_search(b, l, *r); };
+                return true;
+            } catch (std::regex_error const&)
+            {
+                return false;
+            }
+        } });
+
+        all.push_back({ "boost::regex", [](std::string const& pattern, engine& e) {
+            try
+            {
+                auto r = std::make_shared<boost::regex>(pattern);
+                e.find_all = [r](std::string const& text) {
+                    return size_t(std::distance(boost::sregex_iterator(text.begin(), text.end(), *r, boost::match_not_dot_newline), boost::sregex_iterator()));
+                };
+                e.search = [r](char const* b, char const* l) { return boost::regex_search(b, l, *r, boost::match_not_dot_newline); };
+                return true;
+            } catch (std::exception const&)
+            {
+                return false;
+            }
+        } });
+
+        return all;
+    }
+
+    struct result
+    {
+        bool     supported = false;
+        bool     gave_up = false; // the engine threw while scanning
+        double   compile_ms = 0;
+        double   all_mbps = 0, lines_mbps = 0;
+        size_t   matches = 0, matching_lines = 0;
+        size_t   peak_bytes = 0;
+    };
+
+    // MB/s, repeating the scan for at least min_seconds
+    template <typename F> double throughput(double megabytes, F scan)
+    {
+        double const min_seconds = 0.2;
+
+        unsigned rounds = 0;
+        double elapsed = 0;
+        stats::stopwatch timer;
+        do
+        {
+            scan();
+            elapsed += timer.lap();
+            ++rounds;
+        } while (elapsed < min_seconds);
+        return megabytes * rounds / elapsed;
+    }
+
+    // `lines` are the input's, split beforehand so they don't count
+    // towards the engine's peak
+    result measure(compiler const& c, std::string const& pattern, corpus const& input, std::vector<batch::slice> const& lines)
+    {
+        result r;
+        size_t const baseline = heap_live;
+        heap_peak = baseline;
+
+        engine e;
+        stats::stopwatch timer;
+        r.supported = c.compile(pattern, e);
+        r.compile_ms = timer.lap() * 1e3;
+        if (!r.supported)
+            return r;
+
+        double const megabytes = input.text.size() / 1e6;
+
+        try
+        {
+            if (e.find_all)
+                r.all_mbps = throughput(megabytes, [&] { r.matches = e.find_all(input.text); });
+
+            r.lines_mbps = throughput(megabytes, [&] {
+                if (e.count_lines)
+                {
+                    r.matching_lines = e.count_lines(input.text, lines);
+                    return;
+                }
+                r.matching_lines = 0;
+                for (auto& line : lines)
+                    r.matching_lines += e.search(line.begin, line.end);
+            });
+        } catch (std::exception const&) // e.g. boost's complexity limit
+        {
+            r.gave_up = true;
+        }
+
+        r.peak_bytes = heap_peak - baseline;
+        return r;
+    }
+
+    std::ostream& escaped(std::ostream& os, std::string const& v)
+    {
+        for (unsigned char ch : v)
+            if (ch < 0x20 || ch >= 0x7f)
+                os << "\\x" << std::hex << std::setw(2) << std::setfill('0') << unsigned(ch) << std::dec << std::setfill(' ');
+            else
+                os << ch;
+        return os;
+    }
+}
+
+int main()
+{
+    std::vector<corpus> const corpora {
+        log_corpus(1 << 20),
+        text_corpus(1 << 20),
+        runs_corpus('a', 24, 64),
+        runs_corpus('x', 16, 64),
+    };
+    std::vector<std::vector<batch::slice>> lines;
+    for (auto& c : corpora)
+        lines.push_back(batch::lines(c.text));
+
+    struct bench_case { std::string pattern; size_t corpus; };
+    std::vector<bench_case> const cases {
+        // from tree/main.cpp
+        { "abc?",                     1 },
+        { "ab+c",                     1 },
+        { "(ab)+c",                   1 },
+        { "[^-a\\-f-z\"\\]aaaa-]?",   1 },
+        { "abc|d",                    1 },
+        { "a?",                       1 },
+        { ".*?(a|b){,9}?",            1 },
+        { "(XYZ)|(123)",              1 },
+        // from shunting-yard/main.cpp
+        { "(asc)[\x0c\x0a\x0d\x09\x0b]*\x28.*\x29", 1 },
+        // log-like
+        { "ERROR|WARN",                                            0 },
+        { "status=5[0-9][0-9]",                                    0 },
+        { "id=[0-9a-f]{8}",                                        0 },
+        { "[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}", 0 },
+        { "user=[a-z]+@[a-z]+\\.com",                              0 },
+        { "\\[worker-1[0-5]\\].*status=5",                         0 },
+        // keyword sets
+        { keyword_pattern(20),        1 },
+        { keyword_pattern(1000),      1 },
+        // adversarial: backtracking blowup, DFA state blowup
+        { "(a|aa)*b",                 2 },
+        { "(x+x+)+y",                 3 },
+        { "[a-q][^u-z]{13}x",         1 },
+    };
+
+    std::cout << std::left
+              << std::setw(40) << "pattern" << std::setw(10) << "corpus" << std::setw(14) << "engine"
+              << std::right
+              << std::setw(12) << "compile ms" << std::setw(11) << "all MB/s" << std::setw(11) << "lines MB/s"
+              << std::setw(10) << "matches" << std::setw(8) << "lines" << std::setw(12) << "peak KiB" << "\n";
+
+    for (auto& bc : cases)
+    {
+        corpus const& input = corpora[bc.corpus];
+        for (auto& c : compilers())
+        {
+            result const r = measure(c, bc.pattern, input, lines[bc.corpus]);
+
+            std::ostringstream label;
+            escaped(label, bc.pattern);
+            std::cout << std::left
+                      << std::setw(40) << label.str().substr(0, 39) << std::setw(10) << input.name << std::setw(14) << c.name
+                      << std::right << std::fixed << std::setprecision(3);
+            if (!r.supported)
+            {
+                std::cout << std::setw(12) << "n/a" << "\n";
+                continue;
+            }
+            std::cout << std::setw(12) << r.compile_ms << std::setprecision(2);
+            if (r.gave_up)
+            {
+                std::cout << std::setw(11) << "gave up" << "\n";
+                continue;
+            }
+            if (r.all_mbps)
+                std::cout << std::setw(11) << r.all_mbps;
+            else
+                std::cout << std::setw(11) << "-";
+            std::cout << std::setw(11) << r.lines_mbps;
+            if (r.all_mbps)
+                std::cout << std::setw(10) << r.matches;
+            else
+                std::cout << std::setw(10) << "-";
+            std::cout << std::setw(8) << r.matching_lines
+                      << std::setw(12) << (r.peak_bytes + 1023) / 1024 << "\n";
+        }
+    }
+}
@@ -0,0 +1,286 @@
+#include "codegen.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+
+namespace codegen
+{
+    namespace
+    {
+        using dfa::automaton;
+
+        // the states a function can get to from `roots`; `final` states
+        // return, so their transitions are not followed
+        template <typename Final>
+        std::vector<char> reachable(automaton const& a, std::vector<unsigned> const& roots, Final final)
+        {
+            std::vector<char> seen(a.size());
+            std::vector<unsigned> todo;
+            for (auto s : roots)
+                if (!seen[s])
+                {
+                    seen[s] = true;
+                    todo.push_back(s);
+                }
+            while (!todo.empty())
+            {
+                unsigned const s = todo.back();
+                todo.pop_back();
+                if (s == automaton::dead || final(s))
+                    continue;
+                for (unsigned c = 0; c < a.nclasses; ++c)
+                {
+                    unsigned const t = a.next[s * a.nclasses + c];
+                    if (!seen[t])
+                    {
+                        seen[t] = true;
+                        todo.push_back(t);
+                    }
+                }
+            }
+            return seen;
+        }
+
+        // `text` for a // comment: a backslash or a trigraph could join the
+        // next line to it, and a control byte could end it
+        void write_comment(std::ostream& os, std::string const& text)
+        {
+            char const* const hex = "0123456789abcdef";
+            char previous = 0;
+            for (char ch : text)
+            {
+                unsigned char const b = ch;
+                if (b < 0x20 || b >= 0x7f || ch == '\\')
+                    os << "\\x" << hex[b >> 4] << hex[b & 15];
+                else if ((ch == '?' && previous == '?') || (ch == '/' && previous == '*'))
+                    os << "\\" << ch;
+                else
+                    os << ch;
+                previous = ch;
+            }
+        }
+
+        void write_byte(std::ostream& os, unsigned b)
+        {
+            if (std::isalnum(b))
+                os << "'" << char(b) << "'";
+            else
+                os << b;
+        }
+
+        // the switch on the byte `read` yields, with a `goto <label><state>`
+        // per target; the target most bytes go to is the default
+        void write_switch(std::ostream& os, std::string const& indent, automaton const& a, unsigned s, char const* label, char const* read)
+        {
+            std::map<unsigned, std::vector<unsigned>> bytes; // by target
+            for (unsigned b = 0; b < 256; ++b)
+                bytes[a.step(s, b)].push_back(b);
+
+            unsigned most = bytes.begin()->first;
+            for (auto& target : bytes)
+                if (target.second.size() > bytes[most].size())
+                    most = target.first;
+
+            os << indent << "switch (static_cast<unsigned char>(" << read << "))\n"
+               << indent << "{\n";
+            for (auto& target : bytes)
+            {
+                if (target.first == most)
+                    continue;
+                auto const& list = target.second;
+                for (size_t i = 0; i < list.size(); ++i)
+                {
+                    if (i % 8 == 0)
+                        os << (i? "\n" : "") << indent << "    ";
+                    else
+                        os << " ";
+                    os << "case ";
+                    write_byte(os, list[i]);
+                    os << ":";
+                }
+                os << " goto " << label << target.first << ";\n";
+            }
+            os << indent << "    default: goto " << label << most << ";\n"
+               << indent << "}\n";
+        }
+
+        // matcher::search: forward from start[0] until a state decides
+        void write_search(std::ostream& os, automaton const& a)
+        {
+            auto const seen = reachable(a, { a.start[0] }, [&](unsigned s) { return a.accepting[s] != 0; });
+
+            os << "    inline bool search(char const* begin, char const* end)\n"
+               << "    {\n";
+            if (a.accepting[a.start[0]])
+            {
+                // matches the empty string: nothing to read
+                os << "        (void) begin, (void) end;\n"
+                   << "        return true;\n"
+                   << "    }\n";
+                return;
+            }
+            os << "        char const* p = begin;\n"
+               << "        goto s" << a.start[0] << ";\n";
+            for (unsigned s = 0; s < a.size(); ++s)
+            {
+                if (!seen[s])
+                    continue;
+                os << "    s" << s << ":\n";
+                if (s == automaton::dead)
+                    os << "        return false;\n";
+                else if (a.accepting[s])
+                    os << "        return true;\n";
+                else
+                {
+                    os << "        if (p == end)\n"
+                       << "            return " << (a.eot_accepting[s]? "true" : "false") << ";\n";
+                    write_switch(os, "        ", a, s, "s", "*p++");
+                }
+            }
+            os << "    }\n";
+        }
+
+        // the forward half of matcher::find (run_forward in dfa.cpp)
+        void write_forward(std::ostream& os, automaton const& a)
+        {
+            auto const seen = reachable(a, { a.start[0], a.start[1] }, [](unsigned) { return false; });
+
+            os << "        inline char const* forward(char const* begin, char const* end, char const* from, char const*& match_end)\n"
+               << "        {\n"
+               << "            char const* p = from;\n";
+            if (a.start[0] != a.start[1])
+                os << "            if (from == begin)\n"
+                   << "                goto f" << a.start[0] << ";\n";
+            else
+                os << "            (void) begin;\n";
+            os << "            goto f" << a.start[1] << ";\n";
+            for (unsigned s = 0; s < a.size(); ++s)
+            {
+                if (!seen[s])
+                    continue;
+                os << "        f" << s << ":\n";
+                if (s == automaton::dead)
+                {
+                    os << "            return p;\n";
+                    continue;
+                }
+                if (a.accepting[s])
+                    os << "            match_end = p;\n";
+                os << "            if (p == end)\n";
+                if (!a.accepting[s] && a.eot_accepting[s])
+                    os << "            {\n"
+                       << "                match_end = p;\n"
+                       << "                return p;\n"
+                       << "            }\n";
+                else
+                    os << "                return p;\n";
+                write_switch(os, "            ", a, s, "f", "*p++");
+            }
+            os << "        }\n";
+        }
+
+        // the backward half (run_reverse in dfa.cpp), on the mirrored automaton
+        void write_reverse(std::ostream& os, automaton const& a)
+        {
+            auto const seen = reachable(a, { a.start[0], a.start[1] }, [](unsigned) { return false; });
+
+            os << "        inline char const* reverse(char const* begin, char const* from, char const* match_end, bool at_end, char const*& match_begin)\n"
+               << "        {\n"
+               << "            char const* p = match_end;\n"
+               << "            (void) begin;\n";
+            if (a.start[0] != a.start[1])
+                os << "            if (at_end)\n"
+                   << "                goto r" << a.start[0] << ";\n";
+            else
+                os << "            (void) at_end;\n";
+            os << "            goto r" << a.start[1] << ";\n";
+            for (unsigned s = 0; s < a.size(); ++s)
+            {
+                if (!seen[s])
+                    continue;
+                os << "        r" << s << ":\n";
+                if (s == automaton::dead)
+                {
+                    os << "            return p;\n";
+                    continue;
+                }
+                if (a.accepting[s])
+                    os << "            match_begin = p;\n";
+                os << "            if (p == from)\n";
+                if (!a.accepting[s] && a.eot_accepting[s])
+                    os << "            {\n"
+                       << "                if (p == begin)\n"
+                       << "                    match_begin = p;\n"
+                       << "                return p;\n"
+                       << "            }\n";
+                else
+                    os << "                return p;\n";
+                write_switch(os, "            ", a, s, "r", "*--p");
+            }
+            os << "        }\n";
+        }
+    }
+
+    bool identifier(std::string const& name)
+    {
+        static char const* const keywords[] = {
+            "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+            "case", "catch", "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr",
+            "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast",
+            "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+            "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+            "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+            "reinterpret_cast", "return", "short", "signed", "sizeof", "static", "static_assert",
+            "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+            "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+            "volatile", "wchar_t", "while", "xor", "xor_eq",
+        };
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+            return false;
+        for (char ch : name)
+            if (!std::isalnum(static_cast<unsigned char>(ch)) && ch != '_')
+                return false;
+        return std::find(std::begin(keywords), std::end(keywords), name) == std::end(keywords);
+    }
+
+    void write_cpp(std::ostream& os, std::vector<rule> const& rules)
+    {
+        os << "// generated by codegen from the patterns below; do not edit\n"
+           << "\n"
+           << "#include <cstddef>\n";
+
+        for (auto& r : rules)
+        {
+            os << "\n"
+               << "// ";
+            write_comment(os, r.pattern);
+            os << "\n"
+               << "namespace " << r.name << "\n"
+               << "{\n";
+            write_search(os, r.compiled->forward);
+            os << "\n"
+               << "    namespace detail\n"
+               << "    {\n";
+            write_forward(os, r.compiled->forward);
+            os << "\n";
+            write_reverse(os, r.compiled->reverse);
+            os << "    }\n"
+               << "\n"
+               << "    // the leftmost match at or after `from`, as offsets from `begin`\n"
+               << "    inline bool find(char const* begin, char const* end, char const* from, std::size_t& match_begin, std::size_t& match_end)\n"
+               << "    {\n"
+               << "        char const* last = nullptr;\n"
+               << "        detail::forward(begin, end, from, last);\n"
+               << "        if (!last)\n"
+               << "            return false;\n"
+               << "        char const* first = last;\n"
+               << "        detail::reverse(begin, from, last, last == end, first);\n"
+               << "        match_begin = first - begin;\n"
+               << "        match_end = last - begin;\n"
+               << "        return true;\n"
+               << "    }\n"
+               << "}\n";
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef __CODEGEN__
+#define __CODEGEN__
+
+#include "dfa.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace codegen
+{
+    struct rule
+    {
+        std::string name;    // a C++ identifier: the namespace of its functions
+        std::string pattern; // for the comment above them, escaped
+        dfa::matcher const* compiled;
+    };
+
+    // whether `name` can name a namespace: letters, digits and '_', not
+    // starting with a digit, and not a keyword
+    bool identifier(std::string const& name);
+
+    // Writes a self-contained C++ source (only <cstddef>) with, for every
+    // rule, inline functions in namespace `name`:
+    //
+    //   bool search(char const* begin, char const* end);
+    //   bool find(char const* begin, char const* end, char const* from,
+    //             std::size_t& match_begin, std::size_t& match_end);
+    //
+    // with the results of dfa::matcher::search and find. Every state is a
+    // label and every transition a `goto` out of a switch on the byte, as
+    // re2c does: no tables, and the compiler sees each state on its own.
+    void write_cpp(std::ostream& os, std::vector<rule> const& rules);
+}
+
+#endif // __CODEGEN__
@@ -0,0 +1,81 @@
+// Runs the matchers codegen wrote to codegen_check.cpp (the patterns of
+// the codegen_check target in the Makefile) on a fixed set of inputs:
+// search and find must give what dfa::matcher gives for the same
+// pattern. Exits 1 on the first difference of each rule.
+#include "codegen_check.cpp"
+#include "ast.hpp"
+#include "parser.hpp"
+#include "dfa.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct generated
+    {
+        char const* name;
+        char const* pattern; // as passed to codegen
+        bool (*search)(char const*, char const*);
+        bool (*find)(char const*, char const*, char const*, std::size_t&, std::size_t&);
+    };
+
+    generated const rules[] = {
+        { "plain",    "ab+c",           plain::search,    plain::find },
+        { "slash",    "a\\\\",          slash::search,    slash::find },
+        { "newline",  "a\nb",           newline::search,  newline::find },
+        { "trigraph", "[?" "?/]",       trigraph::search, trigraph::find },
+        { "star",     "x*/",            star::search,     star::find },
+        { "anchored", "^[0-9]{2,4}$",   anchored::search, anchored::find },
+    };
+
+    char const* const inputs[] = {
+        "", "a", "abc", "xabbbcx", "abac", "a\\", "xa\\\\", "a\nb", "a\n\nb", "?", "/?", "?" "?/",
+        "x/", "xxx/", "/", "xx", "12", "1234", "12345", "1", "a12", "12\n", "99 99",
+    };
+
+    bool same(generated const& g, dfa::matcher const& m, std::string const& text)
+    {
+        char const* begin = text.data();
+        char const* end   = begin + text.size();
+        if (g.search(begin, end) != m.search(begin, end))
+            return false;
+
+        for (size_t from = 0; from <= text.size(); ++from)
+        {
+            std::size_t match_begin = 0, match_end = 0;
+            bool const found = g.find(begin, end, begin + from, match_begin, match_end);
+            auto const expected = m.find(begin, end, begin + from);
+            if (found != bool(expected) || (found && (match_begin != expected->begin || match_end != expected->end)))
+                return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    int status = 0;
+    for (auto& g : rules)
+    {
+        ast::regex tree;
+        if (!doParse(g.pattern, tree))
+        {
+            std::cerr << "codegen_check: " << g.name << ": cannot parse '" << g.pattern << "'\n";
+            status = 1;
+            continue;
+        }
+        dfa::matcher const m(tree);
+        for (auto input : inputs)
+            if (!same(g, m, input))
+            {
+                std::cerr << "codegen_check: " << g.name << " differs from dfa::matcher on \"";
+                for (auto p = input; *p; ++p)
+                    std::cerr << (*p == '\n'? "\\n" : std::string(1, *p));
+                std::cerr << "\"\n";
+                status = 1;
+                break;
+            }
+    }
+    return status;
+}
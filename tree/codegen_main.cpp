@@ -0,0 +1,47 @@
+// codegen NAME PATTERN [NAME PATTERN...]
+//
+// Compiles every pattern to a DFA and writes C++ matchers for them to
+// stdout (see codegen::write_cpp), one namespace NAME per pattern.
+#include "ast.hpp"
+#include "codegen.hpp"
+#include "parser.hpp"
+#include "dfa.hpp"
+#include <iostream>
+#include <memory>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc % 2 == 0)
+    {
+        std::cerr << "usage: " << argv[0] << " NAME PATTERN [NAME PATTERN...]\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<dfa::matcher>> compiled;
+    std::vector<codegen::rule> rules;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (!codegen::identifier(argv[i]))
+        {
+            std::cerr << argv[0] << ": '" << argv[i] << "' is not a C++ identifier\n";
+            return 1;
+        }
+        for (auto& r : rules)
+            if (r.name == argv[i])
+            {
+                std::cerr << argv[0] << ": " << argv[i] << ": name used twice\n";
+                return 1;
+            }
+
+        ast::regex tree;
+        if (!doParse(argv[i + 1], tree))
+        {
+            std::cerr << argv[0] << ": " << argv[i] << ": cannot parse '" << argv[i + 1] << "'\n";
+            return 1;
+        }
+        compiled.emplace_back(new dfa::matcher(tree));
+        rules.push_back({ argv[i], argv[i + 1], compiled.back().get() });
+    }
+
+    codegen::write_cpp(std::cout, rules);
+}
@@ -0,0 +1,735 @@
+#include "dfa.hpp"
+#include "batch.hpp"
+#include "simd.hpp"
+#include "subset.hpp"
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace dfa
+{
+    using glushkov::symbol_kind;
+
+    unsigned const automaton::dead;
+
+    namespace
+    {
+        // A DFA state is the priority-ordered list of live positions, plus
+        // whether new attempts are still being started. Under
+        // leftmost-longest only the attempt a position belongs to has a
+        // priority, so positions are grouped per attempt (earliest first),
+        // sorted within a group, and groups are split by `separator`.
+        int const separator = -1;
+
+        using items = std::vector<int>;
+        using key   = std::pair<items, bool>; // (positions, restart)
+
+        struct subset_builder : subset::interner<key>
+        {
+            glushkov::automaton const& fa;
+            match_kind const           kind;
+            automaton&                 out;
+            util::sparse_set           seen, visited;
+
+            subset_builder(glushkov::automaton const& fa, match_kind kind, automaton& out)
+                : fa(fa), kind(kind), out(out), seen(fa.positions.size()), visited(fa.positions.size())
+            { }
+
+            void close_group(items& list, items& group) const {
+                if (group.empty())
+                    return;
+                if (kind == match_kind::leftmost_longest)
+                {
+                    std::sort(group.begin(), group.end());
+                    if (!list.empty())
+                        list.push_back(separator);
+                }
+                list.insert(list.end(), group.begin(), group.end());
+                group.clear();
+            }
+
+            bool accepts(items const& list) const {
+                return std::find(list.begin(), list.end(), int(fa.accept())) != list.end();
+            }
+
+            // whether pending end assertions lead to '#' once the text ends
+            // (and, `at_begin`, pending begin assertions too: nothing read)
+            bool accepts_at_end(items const& list, bool at_begin) {
+                bool reached = false;
+                subset::at_end(fa, list, visited, at_begin, [&](unsigned) { reached = true; });
+                return reached;
+            }
+
+            // lower priority attempts can no longer win once '#' is live
+            void truncate(items& list) const {
+                auto it = std::find(list.begin(), list.end(), int(fa.accept()));
+                if (it == list.end())
+                    return;
+                if (kind == match_kind::leftmost_longest)
+                    it = std::find(it, list.end(), separator);
+                else
+                    ++it;
+                list.erase(it, list.end());
+            }
+
+            // the state `list` stands for
+            key normalize(items list, bool restart) const {
+                truncate(list);
+                bool const accepting = accepts(list);
+                return key(std::move(list), restart && !accepting);
+            }
+
+            unsigned intern(key k) {
+                return interner::intern(std::move(k), [&](key const& added) {
+                    bool const accepting = accepts(added.first);
+                    out.accepting.push_back(accepting);
+                    out.eot_accepting.push_back(accepting || accepts_at_end(added.first, false));
+                });
+            }
+
+            unsigned initial(bool at_begin, bool unanchored) {
+                items list, group;
+                seen.clear();
+                for (auto q : fa.first)
+                    subset::enter(fa, q, at_begin, group, seen);
+                close_group(list, group);
+                key k = normalize(std::move(list), unanchored);
+
+                if (at_begin && !accepts(k.first) && !accepts_at_end(k.first, false) && accepts_at_end(k.first, true))
+                    return fresh(std::move(k), [&](key const&) {
+                        out.accepting.push_back(false);
+                        out.eot_accepting.push_back(true);
+                    });
+                return intern(std::move(k));
+            }
+
+            // the state after `byte`, not interned yet; reads nothing that
+            // interning changes, so workers may call it side by side, each
+            // with a `seen` of its own
+            key successor(key const& from, unsigned char byte, util::sparse_set& seen) const {
+                items list, group;
+                seen.clear();
+                for (auto p : from.first)
+                {
+                    if (p == separator)
+                    {
+                        close_group(list, group);
+                        continue;
+                    }
+                    auto const& pos = fa.positions[p];
+                    if (pos.kind == symbol_kind::byte && pos.chars.test(byte))
+                        for (auto q : fa.follow[p])
+                            subset::enter(fa, q, false, group, seen);
+                }
+                close_group(list, group);
+
+                if (from.second)
+                {
+                    for (auto q : fa.first)
+                        subset::enter(fa, q, false, group, seen);
+                    close_group(list, group);
+                }
+                return normalize(std::move(list), from.second);
+            }
+
+            unsigned transition(key const& from, unsigned char byte) {
+                return intern(successor(from, byte, seen));
+            }
+        };
+
+    }
+
+    unsigned byte_classes(glushkov::automaton const& fa, std::array<unsigned char, 256>& classes)
+    {
+        classes.fill(0);
+        unsigned count = 1;
+        for (auto& pos : fa.positions)
+        {
+            if (pos.kind != symbol_kind::byte)
+                continue;
+
+            std::array<int, 512> split;
+            split.fill(-1);
+            count = 0;
+            for (unsigned b = 0; b < 256; ++b)
+            {
+                int& id = split[classes[b] * 2 + pos.chars.test(b)];
+                if (id < 0)
+                    id = count++;
+                classes[b] = id;
+            }
+        }
+        return count;
+    }
+
+    namespace
+    {
+        // false if more than `max_states` (unless 0) states were needed
+        bool subset_construction(glushkov::automaton const& fa, match_kind kind, bool unanchored, unsigned max_states, automaton& out)
+        {
+            out.nclasses = byte_classes(fa, out.classes);
+
+            subset_builder builder(fa, kind, out);
+            builder.intern(key()); // automaton::dead
+            out.start[0] = builder.initial(true, unanchored);
+            out.start[1] = builder.initial(false, unanchored);
+            return subset::expand(builder, out.classes, out.nclasses, out.next, max_states);
+        }
+
+        // The states are expanded in rounds of `round` consecutive ids, their
+        // successors computed on the workers and interned afterwards in
+        // (state, class) order: exactly the order of subset::expand, so the
+        // ids come out the same. Interning is a map lookup per transition;
+        // the unions of followpos lists it waits for are what runs in
+        // parallel.
+        void parallel_construction(glushkov::automaton const& fa, match_kind kind, bool unanchored, batch::pool& workers, automaton& out)
+        {
+            unsigned const round = 4096, per_task = 32; // states
+
+            out.nclasses = byte_classes(fa, out.classes);
+            auto const representative = subset::representatives(out.classes, out.nclasses);
+
+            subset_builder builder(fa, kind, out);
+            builder.intern(key()); // automaton::dead
+            out.start[0] = builder.initial(true, unanchored);
+            out.start[1] = builder.initial(false, unanchored);
+
+            std::vector<key> successors;
+            for (unsigned first = 0; first < builder.states.size();)
+            {
+                unsigned const last = std::min<size_t>(builder.states.size(), size_t(first) + round);
+                successors.assign(size_t(last - first) * out.nclasses, key());
+
+                workers.run((last - first + per_task - 1) / per_task, [&](size_t task) {
+                    util::sparse_set seen(fa.positions.size());
+                    unsigned const from = first + task * per_task;
+                    unsigned const till = std::min(last, from + per_task);
+                    for (unsigned s = from; s < till; ++s)
+                        for (unsigned c = 0; c < out.nclasses; ++c)
+                            successors[size_t(s - first) * out.nclasses + c] = builder.successor(builder.states[s], representative[c], seen);
+                });
+
+                for (auto& k : successors)
+                    out.next.push_back(builder.intern(std::move(k)));
+                first = last;
+            }
+        }
+    }
+
+    automaton determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored)
+    {
+        automaton out;
+        subset_construction(fa, kind, unanchored, 0, out);
+        return out;
+    }
+
+    boost::optional<automaton> determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored, unsigned max_states)
+    {
+        automaton out;
+        if (!subset_construction(fa, kind, unanchored, max_states, out))
+            return boost::none;
+        return out;
+    }
+
+    automaton determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored, batch::pool& workers)
+    {
+        automaton out;
+        parallel_construction(fa, kind, unanchored, workers, out);
+        return out;
+    }
+
+    table layout(automaton const& a, std::vector<unsigned long long> const* visits)
+    {
+        unsigned const n = a.size();
+
+        std::vector<unsigned> bfs;
+        std::vector<char> seen(n);
+        auto visit = [&](unsigned s) {
+            if (!seen[s])
+            {
+                seen[s] = true;
+                bfs.push_back(s);
+            }
+        };
+        visit(a.start[0]);
+        visit(a.start[1]);
+        for (size_t i = 0; i < bfs.size(); ++i)
+            for (unsigned c = 0; c < a.nclasses; ++c)
+                visit(a.next[bfs[i] * a.nclasses + c]);
+        for (unsigned s = 0; s < n; ++s) // unreachable, if any
+            visit(s);
+
+        if (visits && visits->size() == n)
+            std::stable_sort(bfs.begin(), bfs.end(), [&](unsigned x, unsigned y) { return (*visits)[x] > (*visits)[y]; });
+
+        table t;
+        t.classes = a.classes;
+        t.stride  = a.nclasses;
+
+        t.original.push_back(automaton::dead);
+        for (auto s : bfs)
+            if (s != automaton::dead && a.accepting[s])
+                t.original.push_back(s);
+        t.special = t.original.size() * t.stride;
+        for (auto s : bfs)
+            if (s != automaton::dead && !a.accepting[s])
+                t.original.push_back(s);
+
+        std::vector<std::uint32_t> id(n);
+        for (unsigned i = 0; i < n; ++i)
+        {
+            id[t.original[i]] = i * t.stride;
+            t.eot_accepting.push_back(a.eot_accepting[t.original[i]]);
+        }
+        t.start[0] = id[a.start[0]];
+        t.start[1] = id[a.start[1]];
+
+        std::uint32_t const largest = (n - 1) * t.stride;
+        t.width = largest <= 0xff? 1 : largest <= 0xffff? 2 : 4;
+        for (auto s : t.original)
+            for (unsigned c = 0; c < a.nclasses; ++c)
+            {
+                std::uint32_t const to = id[a.next[s * a.nclasses + c]];
+                switch (t.width)
+                {
+                    case 1:  t.next8.push_back(to); break;
+                    case 2:  t.next16.push_back(to); break;
+                    default: t.next32.push_back(to); break;
+                }
+            }
+        return t;
+    }
+
+    std::ostream& write_heatmap(std::ostream& os, automaton const& a, profile::counts const& hits, std::string const& label)
+    {
+        static int graph_id = 0;
+        std::string const prefix = "heat" + std::to_string(++graph_id) + "_";
+
+        auto const visits = [&](unsigned s) { return s < hits.visits.size()? hits.visits[s] : 0; };
+        unsigned long long hottest = 1;
+        for (unsigned s = 0; s < a.size(); ++s)
+            hottest = std::max(hottest, visits(s));
+
+        os << "subgraph cluster_" << prefix << " {\n"
+           << "label=\"";
+        for (char c : label)
+            os << (c == '"' || c == '\\'? "\\" : "") << c;
+        os << " (" << hits.dead_exits << " dead exits)\";\n"
+           << "node[style=filled,fontname=\"Courier\"];\n";
+
+        for (unsigned s = 0; s < a.size(); ++s)
+            os << prefix << s
+               << "[label=\"" << (s == automaton::dead? "dead" : std::to_string(s)) << "\\n" << visits(s) << "\""
+               << ",shape=" << (a.accepting[s]? "doublecircle" : "circle")
+               << ",fillcolor=\"0 " << double(visits(s)) / hottest << " 1\"];\n";
+
+        // the classes that lead to the same state share an edge
+        for (unsigned s = 0; s < a.size(); ++s)
+        {
+            std::map<unsigned, unsigned long long> taken; // by target
+            for (unsigned c = 0; c < a.nclasses; ++c)
+            {
+                size_t const i = size_t(s) * a.nclasses + c;
+                if (i < hits.steps.size() && hits.steps[i])
+                    taken[a.next[i]] += hits.steps[i];
+            }
+            for (auto& edge : taken)
+                os << prefix << s << " -> " << prefix << edge.first
+                   << "[label=\"" << edge.second << "\",penwidth=" << 1 + 4.0 * edge.second / hottest << "];\n";
+        }
+        return os << "}\n";
+    }
+
+    namespace
+    {
+        glushkov::options folded(bool icase, bool mirrored = false)
+        {
+            glushkov::options opts;
+            opts.icase    = icase;
+            opts.mirrored = mirrored;
+            return opts;
+        }
+
+        // The scan loops, one instance per id width. Each runs the narrow
+        // inner loop until it reaches a special state or the end, and only
+        // then looks at which it was.
+
+        // one transition on `byte`, reported to `hits` by automaton state
+        template <typename Id>
+        std::uint32_t step(table const& t, Id const* next, unsigned char const* classes, profile::probe& hits, std::uint32_t s, char byte)
+        {
+            unsigned char const c = classes[static_cast<unsigned char>(byte)];
+            hits.step(t.original[s / t.stride], c);
+            return next[s + c];
+        }
+
+        // forward from `from`: `match_end` is the last match end seen
+        // before the automaton dies; returns where the scan stopped
+        template <typename Id>
+        char const* run_forward(table const& t, Id const* next, profile::probe& hits, char const* begin, char const* end, char const* from, char const*& match_end)
+        {
+            unsigned char const* classes = t.classes.data();
+            std::uint32_t const special = t.special;
+            std::uint32_t s = t.start[from == begin? 0 : 1];
+            char const* p = from;
+            for (;;)
+            {
+                while (s >= special && p != end)
+                    s = step(t, next, classes, hits, s, *p++);
+                if (s >= special)
+                {
+                    if (t.eot_accepting[s / t.stride])
+                        match_end = p;
+                    return p;
+                }
+                if (s == 0)
+                {
+                    hits.dead();
+                    return p;
+                }
+                match_end = p;
+                if (p == end)
+                    return p;
+                s = step(t, next, classes, hits, s, *p++);
+            }
+        }
+
+        // backward from `match_end` down to `from`: `match_begin` is the
+        // last match start seen; returns where the scan stopped
+        template <typename Id>
+        char const* run_reverse(table const& t, Id const* next, profile::probe& hits, char const* begin, char const* from, char const* match_end, bool at_end, char const*& match_begin)
+        {
+            unsigned char const* classes = t.classes.data();
+            std::uint32_t const special = t.special;
+            std::uint32_t s = t.start[at_end? 0 : 1];
+            char const* p = match_end;
+            for (;;)
+            {
+                while (s >= special && p != from)
+                    s = step(t, next, classes, hits, s, *--p);
+                if (s >= special)
+                {
+                    if (p == begin && t.eot_accepting[s / t.stride])
+                        match_begin = p;
+                    return p;
+                }
+                if (s == 0)
+                {
+                    hits.dead();
+                    return p;
+                }
+                match_begin = p;
+                if (p == from)
+                    return p;
+                s = step(t, next, classes, hits, s, *--p);
+            }
+        }
+
+        // whether [begin, end) contains a match, reading no further than
+        // needed to tell; adds the bytes read to `scanned`
+        template <typename Id>
+        bool run_to_first(table const& t, Id const* next, profile::probe& hits, char const* begin, char const* end, size_t& scanned)
+        {
+            unsigned char const* classes = t.classes.data();
+            std::uint32_t const special = t.special;
+            std::uint32_t s = t.start[0];
+            char const* p = begin;
+            while (s >= special && p != end)
+                s = step(t, next, classes, hits, s, *p++);
+            scanned += p - begin;
+            if (s >= special)
+                return t.eot_accepting[s / t.stride];
+            if (s == 0)
+                hits.dead();
+            return s != 0;
+        }
+
+        // run_to_first over many inputs, `lanes` at a time: while every lane
+        // is busy, one round steps each of them once and a single test of
+        // all the new states tells whether one hit a special state
+        template <typename Id>
+        void run_interleaved(table const& t, Id const* next, profile::probe& hits, util::slice const* inputs, size_t count, char* found, size_t& scanned)
+        {
+            unsigned const lanes = 4; // the round below is written out for four
+            unsigned char const* classes = t.classes.data();
+            std::uint32_t const special = t.special;
+
+            char const* p[lanes];
+            char const* end[lanes];
+            std::uint32_t s[lanes];
+            size_t input[lanes];
+            bool busy[lanes] = {};
+            size_t taken = 0;
+
+            for (;;)
+            {
+                unsigned active = 0;
+                for (unsigned i = 0; i < lanes; ++i)
+                {
+                    while (!busy[i] && taken < count)
+                    {
+                        input[i] = taken++;
+                        p[i]     = inputs[input[i]].begin;
+                        end[i]   = inputs[input[i]].end;
+                        s[i]     = t.start[0];
+                        busy[i]  = true;
+                        if (s[i] < special || p[i] == end[i])
+                        {
+                            if (s[i] == 0)
+                                hits.dead();
+                            found[input[i]] = s[i] < special? s[i] != 0 : t.eot_accepting[s[i] / t.stride];
+                            busy[i] = false;
+                        }
+                    }
+                    active += busy[i];
+                }
+                if (active == 0)
+                    return;
+
+                if (active < lanes) // the last few: no partner to overlap with
+                {
+                    for (unsigned i = 0; i < lanes; ++i)
+                        if (busy[i])
+                        {
+                            char const* const from = p[i];
+                            while (s[i] >= special && p[i] != end[i])
+                                s[i] = step(t, next, classes, hits, s[i], *p[i]++);
+                            scanned += p[i] - from;
+                            if (s[i] == 0)
+                                hits.dead();
+                            found[input[i]] = s[i] < special? s[i] != 0 : t.eot_accepting[s[i] / t.stride];
+                        }
+                    return;
+                }
+
+                char const* const started[lanes] = { p[0], p[1], p[2], p[3] };
+                size_t rounds = end[0] - p[0];
+                for (unsigned i = 1; i < lanes; ++i)
+                    rounds = std::min<size_t>(rounds, end[i] - p[i]);
+
+                for (; rounds > 0; --rounds)
+                {
+                    s[0] = step(t, next, classes, hits, s[0], *p[0]++);
+                    s[1] = step(t, next, classes, hits, s[1], *p[1]++);
+                    s[2] = step(t, next, classes, hits, s[2], *p[2]++);
+                    s[3] = step(t, next, classes, hits, s[3], *p[3]++);
+                    if ((s[0] < special) | (s[1] < special) | (s[2] < special) | (s[3] < special))
+                        break;
+                }
+
+                for (unsigned i = 0; i < lanes; ++i)
+                {
+                    scanned += p[i] - started[i];
+                    if (s[i] == 0)
+                        hits.dead();
+                    if (s[i] < special)
+                        found[input[i]] = s[i] != 0;
+                    else if (p[i] == end[i])
+                        found[input[i]] = t.eot_accepting[s[i] / t.stride];
+                    else
+                        continue;
+                    busy[i] = false;
+                }
+            }
+        }
+
+        char const* scan_forward(table const& t, profile::probe& hits, char const* begin, char const* end, char const* from, char const*& match_end)
+        {
+            switch (t.width)
+            {
+                case 1:  return run_forward(t, t.next8.data(), hits, begin, end, from, match_end);
+                case 2:  return run_forward(t, t.next16.data(), hits, begin, end, from, match_end);
+                default: return run_forward(t, t.next32.data(), hits, begin, end, from, match_end);
+            }
+        }
+
+        char const* scan_reverse(table const& t, profile::probe& hits, char const* begin, char const* from, char const* match_end, bool at_end, char const*& match_begin)
+        {
+            switch (t.width)
+            {
+                case 1:  return run_reverse(t, t.next8.data(), hits, begin, from, match_end, at_end, match_begin);
+                case 2:  return run_reverse(t, t.next16.data(), hits, begin, from, match_end, at_end, match_begin);
+                default: return run_reverse(t, t.next32.data(), hits, begin, from, match_end, at_end, match_begin);
+            }
+        }
+
+        void search_interleaved(table const& t, profile::probe& hits, util::slice const* inputs, size_t count, char* found, size_t& scanned)
+        {
+            switch (t.width)
+            {
+                case 1:  return run_interleaved(t, t.next8.data(), hits, inputs, count, found, scanned);
+                case 2:  return run_interleaved(t, t.next16.data(), hits, inputs, count, found, scanned);
+                default: return run_interleaved(t, t.next32.data(), hits, inputs, count, found, scanned);
+            }
+        }
+
+        bool matches_line(table const& t, profile::probe& hits, char const* begin, char const* end, size_t& scanned)
+        {
+            switch (t.width)
+            {
+                case 1:  return run_to_first(t, t.next8.data(), hits, begin, end, scanned);
+                case 2:  return run_to_first(t, t.next16.data(), hits, begin, end, scanned);
+                default: return run_to_first(t, t.next32.data(), hits, begin, end, scanned);
+            }
+        }
+
+        template <typename F>
+        void each_matching_line(table const& t, profile::probe& hits, char const* begin, char const* end, stats::scan* counters, F found)
+        {
+            size_t scanned = 0, matched = 0, number = 0;
+            for (char const* line = begin; line != end; ++number)
+            {
+                char const* eol = util::find_byte(line, end, '\n');
+                if (matches_line(t, hits, line, eol, scanned))
+                {
+                    found(line_match { number, span { size_t(line - begin), size_t(eol - begin) } });
+                    ++matched;
+                }
+                line = eol == end? eol : eol + 1;
+            }
+            if (counters)
+            {
+                counters->bytes += scanned;
+                counters->matches += matched;
+            }
+        }
+
+        void tally(automaton const& a, stats::compile& out)
+        {
+            out.states      += a.size();
+            out.transitions += a.next.size();
+            out.table_bytes += a.next.size() * sizeof(a.next[0])
+                             + a.accepting.size() + a.eot_accepting.size()
+                             + sizeof(a.classes);
+        }
+    }
+
+    matcher::matcher(ast::regex const& tree, match_kind kind, bool icase)
+        : kind(kind)
+    {
+        stats::stopwatch timer;
+        auto const fa  = glushkov::build(tree, folded(icase));
+        auto const rfa = glushkov::build(tree, folded(icase, true));
+        compiled.time.positions = timer.lap();
+
+        forward = determinize(fa, kind, true);
+        reverse = determinize(rfa, match_kind::leftmost_longest, false);
+        compiled.time.determinize = timer.lap();
+
+        forward_scan = layout(forward);
+        reverse_scan = layout(reverse);
+        forward_hits = profile::recorder(forward.size(), forward.nclasses);
+        reverse_hits = profile::recorder(reverse.size(), reverse.nclasses);
+
+        compiled.positions = fa.positions.size();
+        compiled.classes   = forward.nclasses;
+        tally(forward, compiled);
+        tally(reverse, compiled);
+        compiled.table_bytes += forward_scan.bytes() + reverse_scan.bytes();
+    }
+
+    void matcher::reorder(profile::counts const& forward_profile, profile::counts const& reverse_profile)
+    {
+        forward_scan = layout(forward, &forward_profile.visits);
+        reverse_scan = layout(reverse, &reverse_profile.visits);
+    }
+
+    boost::optional<span> matcher::find(char const* begin, char const* end, char const* from, stats::scan* counters) const
+    {
+        // forward: the last match end recorded before the DFA dies belongs
+        // to the winning (leftmost, then by `kind`) match
+        char const* match_end = nullptr;
+        profile::probe ahead(forward_hits);
+        char const* p = scan_forward(forward_scan, ahead, begin, end, from, match_end);
+        if (counters)
+            counters->bytes += p - from;
+
+        if (!match_end)
+            return boost::none;
+
+        // backward: the longest reverse match from the end is the leftmost
+        // start, as no match may start before the winning one
+        char const* match_begin = match_end;
+        profile::probe back(reverse_hits);
+        p = scan_reverse(reverse_scan, back, begin, from, match_end, match_end == end, match_begin);
+        if (counters)
+        {
+            counters->bytes += match_end - p;
+            counters->matches += 1;
+        }
+
+        return span { size_t(match_begin - begin), size_t(match_end - begin) };
+    }
+
+    bool matcher::search(char const* begin, char const* end, stats::scan* counters) const
+    {
+        size_t scanned = 0;
+        profile::probe hits(forward_hits);
+        bool const found = matches_line(forward_scan, hits, begin, end, scanned);
+        if (counters)
+        {
+            counters->bytes += scanned;
+            counters->matches += found;
+        }
+        return found;
+    }
+
+    void matcher::search(util::slice const* inputs, size_t count, char* found, stats::scan* counters) const
+    {
+        size_t scanned = 0;
+        profile::probe hits(forward_hits);
+        search_interleaved(forward_scan, hits, inputs, count, found, scanned);
+        if (counters)
+        {
+            counters->bytes += scanned;
+            for (size_t i = 0; i < count; ++i)
+                counters->matches += found[i];
+        }
+    }
+
+    std::vector<line_match> matcher::match_lines(char const* begin, char const* end, stats::scan* counters) const
+    {
+        std::vector<line_match> lines;
+        profile::probe hits(forward_hits);
+        each_matching_line(forward_scan, hits, begin, end, counters, [&](line_match const& m) { lines.push_back(m); });
+        return lines;
+    }
+
+    std::vector<line_match> matcher::match_lines(std::string const& text, stats::scan* counters) const
+    {
+        return match_lines(text.data(), text.data() + text.size(), counters);
+    }
+
+    size_t matcher::count_lines(char const* begin, char const* end, stats::scan* counters) const
+    {
+        size_t count = 0;
+        profile::probe hits(forward_hits);
+        each_matching_line(forward_scan, hits, begin, end, counters, [&](line_match const&) { ++count; });
+        return count;
+    }
+
+    size_t matcher::count_lines(std::string const& text, stats::scan* counters) const
+    {
+        return count_lines(text.data(), text.data() + text.size(), counters);
+    }
+
+    boost::optional<span> matcher::find(std::string const& text, size_t from, stats::scan* counters) const
+    {
+        char const* begin = text.data();
+        return find(begin, begin + text.size(), begin + from, counters);
+    }
+
+    std::vector<span> matcher::find_all(std::string const& text, stats::scan* counters) const
+    {
+        std::vector<span> matches;
+        for (size_t from = 0; from <= text.size();)
+        {
+            auto m = find(text, from, counters);
+            if (!m)
+                break;
+            matches.push_back(*m);
+            from = m->end > m->begin? m->end : m->end + 1;
+        }
+        return matches;
+    }
+}
@@ -0,0 +1,161 @@
+#ifndef __DFA__
+#define __DFA__
+
+#include "ast.hpp"
+#include "glushkov.hpp"
+#include "profile.hpp"
+#include "slice.hpp"
+#include "stats.hpp"
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace batch { class pool; }
+
+namespace dfa
+{
+    enum class match_kind
+    {
+        leftmost_first,   // perl: alternation order and greediness decide
+        leftmost_longest, // posix: the longest of the leftmost matches
+    };
+
+    struct span
+    {
+        size_t begin, end; // offsets into the subject, end exclusive
+    };
+
+    struct line_match
+    {
+        size_t number; // counted from 0
+        span   bytes;  // without the newline
+    };
+
+    // Subset construction over a position automaton. Byte values that no
+    // position tells apart share a column (equivalence class).
+    struct automaton
+    {
+        static unsigned const dead = 0;
+
+        std::array<unsigned char, 256> classes;
+        unsigned                       nclasses;
+        std::vector<unsigned>          next;          // [state * nclasses + class]
+        std::vector<char>              accepting;     // a match ends before the next byte
+        std::vector<char>              eot_accepting; // a match ends if the text ends here
+
+        // initial state when the scan starts at a text boundary, or not
+        unsigned start[2];
+
+        unsigned size() const { return accepting.size(); }
+        unsigned step(unsigned state, unsigned char byte) const {
+            return next[state * nclasses + classes[byte]];
+        }
+    };
+
+    // An automaton laid out for scanning (see `layout`). A state's id is
+    // premultiplied by the row stride, i.e. it is the offset of its row, so
+    // a step is one add and one load, and ids are stored in the narrowest
+    // type the largest one fits. Dead is 0 and the accepting states come
+    // right after it, so `id < special` catches both with one compare.
+    struct table
+    {
+        std::array<unsigned char, 256> classes;
+        unsigned                       stride;  // = automaton::nclasses
+        unsigned                       width;   // bytes per id: 1, 2 or 4
+        std::vector<std::uint8_t>      next8;   // [id + class]; only the one
+        std::vector<std::uint16_t>     next16;  // of `width` is filled
+        std::vector<std::uint32_t>     next32;
+        std::uint32_t                  special; // ids below are dead or accepting
+        std::uint32_t                  start[2];
+        std::vector<char>              eot_accepting; // [id / stride]
+        std::vector<unsigned>          original;      // [id / stride]: its automaton state
+
+        unsigned size() const { return original.size(); }
+        size_t   bytes() const {
+            return next8.size() + next16.size() * 2 + next32.size() * 4
+                 + eot_accepting.size() + original.size() * sizeof(unsigned) + sizeof(classes);
+        }
+    };
+
+    // Renumbers the states for `table`: dead, the accepting states, then the
+    // others, each group in breadth-first order from the start states so
+    // rows that are visited together share cache lines. With `visits`
+    // (per automaton state, e.g. from a profiling run) each group is sorted
+    // hottest first instead.
+    table layout(automaton const& a, std::vector<unsigned long long> const* visits = nullptr);
+
+    // `a` as a graphviz cluster (to go inside a digraph) shaded by `hits`:
+    // the more bytes read in a state, the redder it is, and every
+    // transition taken is drawn with its count
+    std::ostream& write_heatmap(std::ostream& os, automaton const& a, profile::counts const& hits, std::string const& label);
+
+    // Partition refinement of the byte values by every position's class:
+    // bytes no position tells apart share a class id. Returns the count.
+    unsigned byte_classes(glushkov::automaton const& fa, std::array<unsigned char, 256>& classes);
+
+    // Expects an automaton without counted positions (the default build).
+    // `unanchored` lets a new match attempt start at every byte until the
+    // first match is seen (an implicit lowest-priority `.*?` prefix).
+    automaton determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored);
+
+    // as above, but gives up (none) once there are more than `max_states`
+    // states: a cheap probe for patterns that blow up under determinization
+    boost::optional<automaton> determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored, unsigned max_states);
+
+    // as above, with the subsets of many states built at once on `workers`;
+    // the result is the same automaton, state ids included
+    automaton determinize(glushkov::automaton const& fa, match_kind kind, bool unanchored, batch::pool& workers);
+
+    // Forward DFA to find where the leftmost match ends, then a DFA for the
+    // mirrored pattern run backwards from there to find where it starts.
+    //
+    // `counters`, when given, accumulate the bytes each scan touched (both
+    // directions) and the matches it reported. In a -DDFA_PROFILE build
+    // every scan also counts its steps per state and byte class into
+    // forward_hits and reverse_hits.
+    struct matcher
+    {
+        match_kind        kind;
+        automaton         forward, reverse;
+        table             forward_scan, reverse_scan; // what the scans run on
+        stats::compile    compiled; // sizes of both automata, time to build them
+        profile::recorder forward_hits, reverse_hits;
+
+        // `icase` folds ASCII case into the byte classes (glushkov::options)
+        matcher(ast::regex const& tree, match_kind kind = match_kind::leftmost_first, bool icase = false);
+
+        // lays the scan tables out again, hottest states first (`layout`),
+        // e.g. from forward_hits.merged() and reverse_hits.merged() after a
+        // profiling run over representative input
+        void reorder(profile::counts const& forward_profile, profile::counts const& reverse_profile);
+
+        boost::optional<span> find(char const* begin, char const* end, char const* from, stats::scan* counters = nullptr) const;
+
+        // whether [begin, end) contains a match; forward only, and stops at
+        // the first state that accepts, so it never reads past a match
+        bool search(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+
+        // search() of `count` independent inputs; found[i] tells about
+        // inputs[i]. Four inputs are stepped in lockstep, so the table
+        // loads of one don't wait for those of another; a lane that is
+        // done takes the next input.
+        void search(util::slice const* inputs, size_t count, char* found, stats::scan* counters = nullptr) const;
+
+        // Line mode: each '\n'-terminated line is a subject of its own (so
+        // '^' and '$' hold at its ends) and is reported at most once. Line
+        // ends are found 16 bytes at a time; the forward automaton restarts
+        // at each one and gives up on a line as soon as it matches or dies.
+        // A final newline doesn't start another line.
+        std::vector<line_match> match_lines(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+        std::vector<line_match> match_lines(std::string const& text, stats::scan* counters = nullptr) const;
+        size_t                  count_lines(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+        size_t                  count_lines(std::string const& text, stats::scan* counters = nullptr) const;
+        boost::optional<span> find(std::string const& text, size_t from = 0, stats::scan* counters = nullptr) const;
+        std::vector<span>     find_all(std::string const& text, stats::scan* counters = nullptr) const;
+    };
+}
+
+#endif // __DFA__
@@ -0,0 +1,260 @@
+#include "flat.hpp"
+#include <map>
+
+namespace flat
+{
+    size_t tree::size_bytes() const
+    {
+        return nodes.size()           * sizeof(node)
+             + children.size()        * sizeof(index)
+             + literal_chars.size()
+             + literal_offsets.size() * sizeof(index)
+             + charsets.size()        * sizeof(charset)
+             + charset_items.size()   * sizeof(charset_item);
+    }
+
+    namespace
+    {
+        index const no_slot = index(-1); // the root has no parent slot
+
+        // Pre-order over the ast with an explicit stack. Every node reserves
+        // its child slots in `children` up front; a child fills its slot in
+        // when it is popped and numbered.
+        class flattener : public boost::static_visitor<index>
+        {
+            using task = boost::variant<ast::alternative const*, ast::sequence const*, ast::atom const*, ast::simple const*>;
+
+            struct as_task : boost::static_visitor<task>
+            {
+                template <typename T> task operator()(T const& v) const { return &v; }
+            };
+
+            struct pending
+            {
+                task  what;
+                index slot;
+            };
+
+            tree&                        out;
+            std::vector<pending>         todo;
+            std::map<std::string, index> literal_ids, charset_ids;
+
+            index add(node_kind kind, index count)
+            {
+                node const n = { kind, true, index(out.children.size()), count, 1, 1 };
+                out.children.resize(out.children.size() + count, 0);
+                out.nodes.push_back(n);
+                return out.nodes.size() - 1;
+            }
+
+            template <typename Children> index add_list(node_kind kind, Children const& items)
+            {
+                index const n = add(kind, items.size());
+                for (size_t i = items.size(); i-- > 0;)
+                    todo.push_back({ &items[i], index(out.nodes[n].value + i) });
+                return n;
+            }
+
+            index intern_literal(std::string const& v)
+            {
+                auto found = literal_ids.find(v);
+                if (found != literal_ids.end())
+                    return found->second;
+
+                out.literal_chars += v;
+                out.literal_offsets.push_back(out.literal_chars.size());
+                return literal_ids[v] = out.literal_offsets.size() - 2;
+            }
+
+            index intern_charset(ast::charset const& v)
+            {
+                std::vector<charset_item> items;
+                std::string key(1, v.negated);
+                for (auto& el : v.elements)
+                {
+                    if (auto r = boost::get<ast::charset::range>(&el))
+                        items.push_back({ boost::get<0>(*r), boost::get<1>(*r), true });
+                    else
+                        items.push_back({ boost::get<char>(el), boost::get<char>(el), false });
+                    key += items.back().from;
+                    key += items.back().till;
+                    key += char(items.back().range);
+                }
+
+                auto found = charset_ids.find(key);
+                if (found != charset_ids.end())
+                    return found->second;
+
+                out.charsets.push_back({ v.negated, index(out.charset_items.size()), index(items.size()) });
+                out.charset_items.insert(out.charset_items.end(), items.begin(), items.end());
+                return charset_ids[key] = out.charsets.size() - 1;
+            }
+
+          public:
+            explicit flattener(tree& out) : out(out) {
+                out.literal_offsets.assign(1, 0);
+            }
+
+            void run(ast::regex const& root)
+            {
+                todo.push_back({ boost::apply_visitor(as_task(), root), no_slot });
+                while (!todo.empty())
+                {
+                    pending const current = todo.back();
+                    todo.pop_back();
+
+                    index const n = boost::apply_visitor(*this, current.what);
+                    if (current.slot == no_slot)
+                        out.root = n;
+                    else
+                        out.children[current.slot] = n;
+                }
+            }
+
+            index operator()(ast::alternative const* v) { return add_list(node_kind::alternative, *v); }
+            index operator()(ast::sequence const* v)    { return add_list(node_kind::sequence, *v); }
+            index operator()(ast::simple const* v)      { return boost::apply_visitor(*this, *v); }
+
+            index operator()(ast::atom const* v) {
+                index const n = add(node_kind::atom, 1);
+                node& a  = out.nodes[n];
+                a.greedy = v->mult.greedy;
+                a.min    = v->mult.minoccurs;
+                a.max    = v->mult.unbounded()? unbounded : *v->mult.maxoccurs;
+                todo.push_back({ &v->expr, a.value });
+                return n;
+            }
+
+            index operator()(ast::group const& v) {
+                index const n = add(node_kind::group, 1);
+                todo.push_back({ &v.root, out.nodes[n].value });
+                return n;
+            }
+
+            index operator()(std::string const& v) {
+                index const id = intern_literal(v);
+                index const n  = add(node_kind::literal, 0);
+                out.nodes[n].value = id;
+                return n;
+            }
+
+            index operator()(ast::charset const& v) {
+                index const id = intern_charset(v);
+                index const n  = add(node_kind::charset, 0);
+                out.nodes[n].value = id;
+                return n;
+            }
+
+            index operator()(ast::any_char const&)       { return add(node_kind::any_char, 0); }
+            index operator()(ast::start_of_match const&) { return add(node_kind::start_of_match, 0); }
+            index operator()(ast::end_of_match const&)   { return add(node_kind::end_of_match, 0); }
+        };
+
+        // Top-down rebuild: each node sizes its ast object, then queues its
+        // children against their final addresses (which stay put, since no
+        // container is resized after its children are queued).
+        class unflattener : public boost::static_visitor<>
+        {
+            using target = boost::variant<ast::regex*, ast::alternative*, ast::sequence*, ast::atom*, ast::simple*>;
+
+            struct pending
+            {
+                index  from;
+                target into;
+            };
+
+            tree const&          in;
+            std::vector<pending> todo;
+            node                 current;
+
+            template <typename Children> void fill_list(Children* items)
+            {
+                items->resize(current.count);
+                for (size_t i = current.count; i-- > 0;)
+                    todo.push_back({ in.child(current, i), &(*items)[i] });
+            }
+
+          public:
+            explicit unflattener(tree const& in) : in(in) {}
+
+            void run(ast::regex& root)
+            {
+                todo.push_back({ in.root, &root });
+                while (!todo.empty())
+                {
+                    pending const p = todo.back();
+                    todo.pop_back();
+
+                    current = in[p.from];
+                    boost::apply_visitor(*this, p.into);
+                }
+            }
+
+            void operator()(ast::regex* v) {
+                switch (current.kind)
+                {
+                    case node_kind::alternative: *v = ast::alternative(); return (*this)(boost::get<ast::alternative>(v));
+                    case node_kind::sequence:    *v = ast::sequence();    return (*this)(boost::get<ast::sequence>(v));
+                    default:                     *v = ast::atom();        return (*this)(boost::get<ast::atom>(v));
+                }
+            }
+
+            void operator()(ast::alternative* v) { fill_list(v); }
+            void operator()(ast::sequence* v)    { fill_list(v); }
+
+            void operator()(ast::atom* v) {
+                v->mult = ast::multiplicity(current.min, current.max == unbounded? boost::optional<unsigned>() : current.max);
+                v->mult.greedy = current.greedy;
+                todo.push_back({ in.child(current), &v->expr });
+            }
+
+            void operator()(ast::simple* v) {
+                switch (current.kind)
+                {
+                    case node_kind::group:
+                        *v = ast::group();
+                        todo.push_back({ in.child(current), &boost::get<ast::group>(*v).root });
+                        break;
+                    case node_kind::literal:
+                        *v = in.literal(current.value).to_string();
+                        break;
+                    case node_kind::charset:
+                        {
+                            charset const& cs = in.charsets[current.value];
+                            ast::charset set;
+                            set.negated = cs.negated;
+                            for (index i = cs.first; i < cs.first + cs.count; ++i)
+                            {
+                                charset_item const& item = in.charset_items[i];
+                                if (item.range)
+                                    set.elements.insert(ast::charset::range(item.from, item.till));
+                                else
+                                    set.elements.insert(item.from);
+                            }
+                            *v = std::move(set);
+                        }
+                        break;
+                    case node_kind::any_char:       *v = ast::any_char();       break;
+                    case node_kind::start_of_match: *v = ast::start_of_match(); break;
+                    case node_kind::end_of_match:   *v = ast::end_of_match();   break;
+                    default:
+                        break; // not a simple expression; a well-formed tree has none here
+                }
+            }
+        };
+    }
+
+    tree from_ast(ast::regex const& root)
+    {
+        tree out;
+        flattener(out).run(root);
+        return out;
+    }
+
+    ast::regex to_ast(tree const& t)
+    {
+        ast::regex root;
+        unflattener(t).run(root);
+        return root;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef __FLAT__
+#define __FLAT__
+
+#include "ast.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace flat
+{
+    using index = std::uint32_t;
+
+    static index const unbounded = index(-1); // node::max without upper bound
+
+    enum class node_kind : std::uint8_t
+    {
+        alternative,    // children: sequences
+        sequence,       // children: atoms
+        atom,           // one child: the quantified simple expression
+        group,          // one child: an alternative
+        literal,        // `value` names a string in the literal pool
+        charset,        // `value` names a set in the charset pool
+        any_char,
+        start_of_match,
+        end_of_match,
+    };
+
+    struct node
+    {
+        node_kind kind;
+        bool      greedy;     // atom
+        index     value;      // offset into `children`, or a pool id
+        index     count;      // number of children
+        index     min, max;   // atom
+    };
+
+    struct charset_item
+    {
+        char from, till;      // a loose char has from == till
+        bool range;
+    };
+
+    struct charset
+    {
+        bool  negated;
+        index first, count;   // into `charset_items`, in ast order
+    };
+
+    // The ast::regex of a pattern in a handful of flat arrays: one node
+    // array linked by 32-bit indices, and interned pools for the literal
+    // strings and charsets (equal ones are stored once).
+    //
+    // Nodes are numbered in pre-order, so a child always comes after its
+    // parent and a linear pass over `nodes` visits the tree depth first.
+    struct tree
+    {
+        std::vector<node>         nodes;
+        std::vector<index>        children;
+        std::string               literal_chars;
+        std::vector<index>        literal_offsets; // literal i is [offsets[i], offsets[i+1])
+        std::vector<charset>      charsets;
+        std::vector<charset_item> charset_items;
+        index                     root = 0;
+
+        node const& operator[](index i) const { return nodes[i]; }
+        index child(node const& n, index i = 0) const { return children[n.value + i]; }
+
+        boost::string_ref literal(index id) const {
+            return boost::string_ref(literal_chars.data() + literal_offsets[id], literal_offsets[id+1] - literal_offsets[id]);
+        }
+
+        // bytes held by the arrays
+        size_t size_bytes() const;
+    };
+
+    // lossless both ways: to_ast(from_ast(t)) is equal to t
+    tree       from_ast(ast::regex const& root);
+    ast::regex to_ast(tree const& t);
+}
+
+#endif // __FLAT__
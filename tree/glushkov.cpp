@@ -0,0 +1,377 @@
+#include "glushkov.hpp"
+#include "parser.hpp"
+#include <algorithm>
+#include <functional>
+#include <map>
+
+namespace glushkov
+{
+    namespace
+    {
+        using list = std::vector<unsigned>;
+
+        // placeholder continuation for the body of a loop; it is patched with
+        // the loop's own firstpos once that is known
+        unsigned const marker_base = 0x80000000u;
+
+        struct charset_filler : boost::static_visitor<>
+        {
+            charclass& chars;
+            charset_filler(charclass& chars) : chars(chars) {}
+
+            void operator()(char v) const { chars.set(static_cast<unsigned char>(v)); }
+            void operator()(ast::charset::range const& v) const {
+                using boost::get;
+                for (unsigned ch = static_cast<unsigned char>(get<0>(v)); ch <= static_cast<unsigned char>(get<1>(v)); ++ch)
+                    chars.set(ch);
+            }
+        };
+
+        void fold_case(charclass& chars)
+        {
+            for (unsigned lower = 'a'; lower <= 'z'; ++lower)
+            {
+                unsigned const upper = lower - 'a' + 'A';
+                if (chars.test(lower) || chars.test(upper))
+                    chars.set(lower).set(upper);
+            }
+        }
+
+        // whether a simple expression compiles to exactly one position
+        struct single_position : boost::static_visitor<bool>
+        {
+            bool operator()(ast::any_char const&) const { return true; }
+            bool operator()(ast::charset const&)  const { return true; }
+            bool operator()(std::string const& v) const { return v.size() == 1; }
+            bool operator()(ast::group const& v)  const {
+                if (v.root.size() != 1 || v.root[0].size() != 1)
+                    return false;
+                auto& only = v.root[0][0];
+                return only.mult.minoccurs == 1 && !only.mult.repeating() && boost::apply_visitor(*this, only.expr);
+            }
+            template <typename T> bool operator()(T const&) const { return false; }
+        };
+
+        // numbers the groups in the order of their '(' (pre-order), from 1
+        struct group_numbering : boost::static_visitor<>
+        {
+            std::map<ast::group const*, unsigned>& ids;
+            group_numbering(std::map<ast::group const*, unsigned>& ids) : ids(ids) {}
+
+            void operator()(ast::alternative const& a) const { for (auto& s : a) (*this)(s); }
+            void operator()(ast::sequence const& s)    const { for (auto& a : s) (*this)(a); }
+            void operator()(ast::atom const& a)        const { boost::apply_visitor(*this, a.expr); }
+            void operator()(ast::group const& g)       const {
+                ids.emplace(&g, ids.size() + 1);
+                (*this)(g.root);
+            }
+            template <typename T> void operator()(T const&) const { }
+        };
+
+        // Assigns positions while walking the tree top-down with the
+        // continuation `k` (the ordered firstpos of whatever follows the
+        // node); each leaf's followpos is exactly the continuation it is
+        // reached with. Returns the node's firstpos given `k`.
+        //
+        // Positions are allocated right-to-left, `build` renumbers them.
+        struct followpos_builder : boost::static_visitor<list>
+        {
+            automaton& fa;
+            bool const mirrored;
+            unsigned const count_above;
+            bool const captures;
+            bool const icase;
+            unsigned markers = 0;
+            std::map<ast::group const*, unsigned> group_ids;
+            std::vector<char> position_marks, marker_marks; // all clear between unions
+
+            followpos_builder(automaton& fa, options const& opts)
+                : fa(fa), mirrored(opts.mirrored), count_above(opts.count_above), captures(opts.captures), icase(opts.icase) {}
+
+            char& mark(unsigned p) {
+                auto& marks = p >= marker_base? marker_marks : position_marks;
+                unsigned const i = p >= marker_base? p - marker_base : p;
+                if (marks.size() <= i)
+                    marks.resize(i + 1);
+                return marks[i];
+            }
+
+            // ordered union: keeps the first occurrence (= highest priority);
+            // linear in both lists, which unrolling e{m,n} relies on
+            void append_unique(list& dst, list const& src) {
+                for (auto p : dst)
+                    mark(p) = true;
+                for (auto p : src)
+                    if (!mark(p))
+                    {
+                        mark(p) = true;
+                        dst.push_back(p);
+                    }
+                for (auto p : dst)
+                    mark(p) = false;
+            }
+
+            list merged(list a, list const& b) {
+                append_unique(a, b);
+                return a;
+            }
+
+            void substitute(list& l, unsigned marker, list const& with) {
+                auto it = std::find(l.begin(), l.end(), marker);
+                if (it == l.end())
+                    return;
+
+                list out(l.begin(), it);
+                append_unique(out, with);
+                append_unique(out, list(it + 1, l.end()));
+                l.swap(out);
+            }
+
+            unsigned emit(symbol_kind kind, charclass const& chars, list const& k) {
+                fa.positions.push_back({ kind, chars, 0, 0, 0 });
+                fa.follow.push_back(k);
+                return fa.positions.size() - 1;
+            }
+
+            // the group's open and close tags around `inside`
+            template <typename F> list tagged(unsigned group, list const& k, F inside) {
+                unsigned const close = emit(symbol_kind::tag, charclass(), k);
+                fa.positions[close].tag = 2 * group + 1;
+                unsigned const open = emit(symbol_kind::tag, charclass(), inside(list { close }));
+                fa.positions[open].tag = 2 * group;
+                return { open };
+            }
+
+            list operator()(ast::alternative const& a, list const& k) {
+                std::vector<list> firsts(a.size());
+                for (size_t i = a.size(); i-- > 0;)
+                    firsts[i] = (*this)(a[i], k);
+
+                list first;
+                for (auto& f : firsts)
+                    append_unique(first, f);
+                return first;
+            }
+
+            list operator()(ast::sequence const& s, list const& k) {
+                list cur = k;
+                if (mirrored)
+                    for (auto it = s.begin(); it != s.end(); ++it)
+                        cur = (*this)(*it, cur);
+                else
+                    for (auto it = s.rbegin(); it != s.rend(); ++it)
+                        cur = (*this)(*it, cur);
+                return cur;
+            }
+
+            list operator()(ast::atom const& v, list const& k) {
+                return repeat(v.expr, v.mult, k);
+            }
+
+            list operator()(ast::start_of_match const& v, list const& k) {
+                return { emit(mirrored? symbol_kind::end_assert : symbol_kind::begin_assert, charclass(), k) };
+            }
+            list operator()(ast::end_of_match const& v, list const& k) {
+                return { emit(mirrored? symbol_kind::begin_assert : symbol_kind::end_assert, charclass(), k) };
+            }
+            list operator()(ast::any_char const& v, list const& k) {
+                charclass chars;
+                chars.set().reset('\n');
+                return { emit(symbol_kind::byte, chars, k) };
+            }
+            list operator()(ast::charset const& v, list const& k) {
+                charclass chars;
+                for (auto& el : v.elements)
+                    boost::apply_visitor(charset_filler(chars), el);
+                if (icase)
+                    fold_case(chars);
+                if (v.negated)
+                    chars.flip();
+                return { emit(symbol_kind::byte, chars, k) };
+            }
+            list operator()(std::string const& v, list const& k) {
+                list cur = k;
+                auto literal = [&](char ch) {
+                    charclass chars;
+                    chars.set(static_cast<unsigned char>(ch));
+                    if (icase)
+                        fold_case(chars);
+                    cur = { emit(symbol_kind::byte, chars, cur) };
+                };
+                if (mirrored)
+                    std::for_each(v.begin(), v.end(), literal);
+                else
+                    std::for_each(v.rbegin(), v.rend(), literal);
+                return cur;
+            }
+            list operator()(ast::group const& v, list const& k) {
+                if (captures)
+                    return tagged(group_ids.at(&v), k, [&](list const& inner) { return (*this)(v.root, inner); });
+                return (*this)(v.root, k);
+            }
+
+          private:
+            list simple(ast::simple const& e, list const& k) {
+                return boost::apply_visitor(std::bind(std::ref(*this), std::placeholders::_1, std::cref(k)), e);
+            }
+
+            // counted repeats are unrolled: e{2,4} == e e (e (e)?)?
+            list repeat(ast::simple const& e, ast::multiplicity const& m, list const& k) {
+                if (count_above && !captures && !m.unbounded() && *m.maxoccurs > count_above
+                        && boost::apply_visitor(single_position(), e))
+                    return counted(e, m, k);
+
+                list cur = k;
+                if (m.unbounded())
+                    cur = star(e, m.greedy, cur);
+                else
+                    for (unsigned i = m.minoccurs; i < *m.maxoccurs; ++i)
+                        cur = optional(e, m.greedy, cur);
+
+                for (unsigned i = 0; i < m.minoccurs; ++i)
+                    cur = simple(e, cur);
+                return cur;
+            }
+
+            list optional(ast::simple const& e, bool greedy, list const& k) {
+                list const f = simple(e, k);
+                return greedy? merged(f, k) : merged(k, f);
+            }
+
+            list star(ast::simple const& e, bool greedy, list const& k) {
+                unsigned const marker = marker_base + markers++;
+                size_t const body = fa.positions.size();
+
+                list const f = empty_exits(simple(e, { marker }), marker, k);
+
+                list const loop = greedy? merged(f, k) : merged(k, f);
+                for (size_t p = body; p < fa.positions.size(); ++p)
+                    substitute(fa.follow[p], marker, loop);
+                return loop;
+            }
+
+            // A loop's firstpos `l` as entered, where an empty iteration
+            // leaves the loop at the rank the body gives it instead of
+            // entering the loop again at the same offset. The tags on such
+            // a path are copied, since the body's other paths through them
+            // still loop.
+            list empty_exits(list const& l, unsigned marker, list const& k) {
+                std::map<unsigned, unsigned> copies;
+                return empty_exits(l, marker, k, copies);
+            }
+
+            list empty_exits(list const& l, unsigned marker, list const& k, std::map<unsigned, unsigned>& copies) {
+                list out;
+                for (auto p : l)
+                {
+                    if (p == marker)
+                    {
+                        append_unique(out, k);
+                        continue;
+                    }
+                    if (p < marker_base && fa.positions[p].kind == symbol_kind::tag)
+                    {
+                        auto found = copies.find(p);
+                        if (found == copies.end())
+                        {
+                            list const follow = empty_exits(fa.follow[p], marker, k, copies);
+                            unsigned copy = p;
+                            if (follow != fa.follow[p])
+                            {
+                                copy = emit(symbol_kind::tag, charclass(), follow);
+                                fa.positions[copy].tag = fa.positions[p].tag;
+                            }
+                            found = copies.emplace(p, copy).first;
+                        }
+                        p = found->second;
+                    }
+                    append_unique(out, { p });
+                }
+                return out;
+            }
+
+            // one position whose loop onto itself is implicit (see
+            // `position::max_count`): its follow holds the exits only, so
+            // `p` in it is a fresh iteration, e.g. of an enclosing star. The
+            // simulation keeps the iteration count and gates the loop (< max)
+            // and the exits (>= min).
+            list counted(ast::simple const& e, ast::multiplicity const& m, list const& k) {
+                list const f = simple(e, k);
+                unsigned const p = f.front();
+
+                fa.positions[p].min_count = m.minoccurs;
+                fa.positions[p].max_count = *m.maxoccurs;
+
+                if (m.minoccurs)
+                    return f;
+                return m.greedy? merged(f, k) : merged(k, f);
+            }
+        };
+    }
+
+    automaton build(ast::regex const& tree, options const& opts)
+    {
+        automaton fa;
+        followpos_builder builder(fa, opts);
+
+        unsigned const accept = builder.emit(symbol_kind::accept, charclass(), {});
+        auto const whole = [&](list const& k) {
+            return boost::apply_visitor(std::bind(std::ref(builder), std::placeholders::_1, std::cref(k)), tree);
+        };
+        if (opts.captures)
+        {
+            boost::apply_visitor(group_numbering(builder.group_ids), tree);
+            fa.first = builder.tagged(0, { accept }, whole);
+        } else
+            fa.first = whole({ accept });
+
+        // renumber so positions read left-to-right and '#' comes last
+        unsigned const n = fa.positions.size();
+        std::reverse(fa.positions.begin(), fa.positions.end());
+        std::reverse(fa.follow.begin(), fa.follow.end());
+        for (auto& l : fa.follow)
+            for (auto& p : l)
+                p = n - 1 - p;
+        for (auto& p : fa.first)
+            p = n - 1 - p;
+
+        return fa;
+    }
+
+    boost::optional<automaton> compile(std::string const& pattern, options const& opts)
+    {
+        ast::regex tree;
+        if (!doParse(pattern, tree))
+            return boost::none;
+        return build(tree, opts);
+    }
+
+    automaton combine(std::vector<automaton const*> const& parts, std::vector<int>& accept_of)
+    {
+        automaton out;
+        accept_of.clear();
+        for (unsigned i = 0; i < parts.size(); ++i)
+        {
+            auto const& fa = *parts[i];
+            unsigned const offset = out.positions.size();
+            for (unsigned p = 0; p < fa.positions.size(); ++p)
+            {
+                out.positions.push_back(fa.positions[p]);
+                accept_of.push_back(p == fa.accept()? int(i) : -1);
+                out.follow.emplace_back();
+                for (auto q : fa.follow[p])
+                    out.follow.back().push_back(q + offset);
+            }
+            for (auto q : fa.first)
+                out.first.push_back(q + offset);
+        }
+        return out;
+    }
+
+    unsigned count_groups(ast::regex const& tree)
+    {
+        std::map<ast::group const*, unsigned> ids;
+        boost::apply_visitor(group_numbering(ids), tree);
+        return ids.size() + 1;
+    }
+}
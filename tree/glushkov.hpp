@@ -0,0 +1,98 @@
+#ifndef __GLUSHKOV__
+#define __GLUSHKOV__
+
+#include "ast.hpp"
+#include <bitset>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace glushkov
+{
+    using charclass = std::bitset<256>;
+
+    enum class symbol_kind : unsigned char
+    {
+        byte,         // consumes one input byte out of `chars`
+        begin_assert, // zero-width, holds where the scan started at a text boundary
+        end_assert,   // zero-width, holds where the scan finishes at a text boundary
+        accept,       // the '#' end marker
+        tag,          // zero-width, records the current offset in tag `tag`
+    };
+
+    struct position
+    {
+        symbol_kind kind;
+        charclass   chars;
+
+        // bounds of a counted repeat kept as this single position (see
+        // `options::count_above`); max_count is 0 for ordinary positions.
+        // Its edge back to itself is not in `follow`: the counter's loop is
+        // implied, and the position in its own follow list means a new
+        // iteration of an enclosing loop, with a counter of its own.
+        unsigned    min_count, max_count;
+
+        unsigned    tag; // for symbol_kind::tag
+
+        bool counted() const { return max_count != 0; }
+    };
+
+    // Position automaton of a pattern: the nullable/firstpos/lastpos/followpos
+    // tables, with the '#' end marker as the last position.
+    //
+    // `follow` and `first` are ordered by match priority (leftmost branch,
+    // greedy iteration first), so leftmost-first consumers can honour them;
+    // set-based consumers simply ignore the order.
+    struct automaton
+    {
+        std::vector<position>              positions;
+        std::vector<std::vector<unsigned>> follow;
+        std::vector<unsigned>              first;
+
+        unsigned accept() const { return positions.size() - 1; }
+    };
+
+    struct options
+    {
+        // build the automaton of the reversed language: sequences and
+        // literals are walked right-to-left and `^`/`$` swap roles, so it
+        // can be run backwards over the text
+        bool mirrored = false;
+
+        // a bounded repeat of a single position (`[0-9]{1,1000}`, `.{,9}`)
+        // whose upper bound exceeds this becomes one counted position with a
+        // self loop instead of being unrolled; 0 always unrolls. Only the
+        // counting simulation (nfa.hpp) understands counted positions.
+        unsigned count_above = 0;
+
+        // bracket every group with tag positions: group g (numbered by its
+        // '(' from 1, 0 being the whole pattern) opens with tag 2g and closes
+        // with tag 2g+1. Only the tagged DFA (tdfa.hpp) understands them;
+        // counted repeats are unrolled while this is on.
+        bool captures = false;
+
+        // fold ASCII case into every literal and charset class, so `a`
+        // compiles to the one position {a,A}; negated sets are folded before
+        // they are complemented (`[^a]` excludes both)
+        bool icase = false;
+    };
+
+    // number of capture groups in the pattern, including group 0
+    unsigned count_groups(ast::regex const& tree);
+
+    // Walks the tree once, every node type of ast.hpp included: no postfix
+    // or other intermediate form is written out and parsed again.
+    automaton build(ast::regex const& tree, options const& opts = options());
+
+    // the automata of several patterns side by side in one: positions are
+    // renumbered by offset, `first` is theirs concatenated in order, and
+    // each keeps its own '#', whose index into `parts` `accept_of` gives
+    // (-1 for every other position)
+    automaton combine(std::vector<automaton const*> const& parts, std::vector<int>& accept_of);
+
+    // pattern text to positions in one call (doParse, then build); none if
+    // the text doesn't parse
+    boost::optional<automaton> compile(std::string const& pattern, options const& opts = options());
+}
+
+#endif // __GLUSHKOV__
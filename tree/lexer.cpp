@@ -0,0 +1,130 @@
+#include "lexer.hpp"
+#include "dfa.hpp"
+#include "subset.hpp"
+
+namespace lexer
+{
+    unsigned const automaton::dead;
+    int const      automaton::none;
+    std::uint32_t const scanner::unmatched;
+
+    namespace
+    {
+        // a state accepts for the first rule whose '#' is live
+        struct first_rule
+        {
+            using value = int;
+
+            static int  none() { return automaton::none; }
+            static void add(int& v, unsigned rule) {
+                if (v == automaton::none || int(rule) < v)
+                    v = rule;
+            }
+        };
+    }
+
+    automaton determinize(std::vector<glushkov::automaton> const& rules)
+    {
+        std::vector<glushkov::automaton const*> parts;
+        for (auto& r : rules)
+            parts.push_back(&r);
+        std::vector<int> rule_of;
+        auto const fa = glushkov::combine(parts, rule_of);
+
+        automaton out;
+        out.nclasses = dfa::byte_classes(fa, out.classes);
+
+        subset::set_builder<first_rule> builder(fa, rule_of, false); // 0 is automaton::dead
+        out.start[0] = builder.initial(true);
+        out.start[1] = builder.initial(false);
+        subset::expand(builder, out.classes, out.nclasses, out.next);
+
+        out.accepts     = std::move(builder.accepts);
+        out.eot_accepts = std::move(builder.eot_accepts);
+        return out;
+    }
+
+    scanner::scanner(std::vector<rule> const& rules)
+    {
+        stats::stopwatch timer;
+        std::vector<glushkov::automaton> automata;
+        for (auto& r : rules)
+        {
+            automata.push_back(glushkov::build(r.tree));
+            ids.push_back(r.id);
+            compiled.positions += automata.back().positions.size();
+        }
+        compiled.time.positions = timer.lap();
+
+        tokens = determinize(automata);
+        compiled.time.determinize = timer.lap();
+
+        compiled.states      = tokens.size();
+        compiled.classes     = tokens.nclasses;
+        compiled.transitions = tokens.next.size();
+        compiled.table_bytes = tokens.next.size() * sizeof(tokens.next[0])
+                             + (tokens.accepts.size() + tokens.eot_accepts.size()) * sizeof(int)
+                             + sizeof(tokens.classes);
+    }
+
+    void scanner::tokenize(char const* begin, char const* end, std::vector<token>& out, stats::scan* counters) const
+    {
+        automaton const& a = tokens;
+        unsigned const* next = a.next.data();
+        int const* accepts = a.accepts.data();
+        unsigned const nclasses = a.nclasses;
+
+        size_t scanned = 0, found = 0;
+        for (char const* p = begin; p != end;)
+        {
+            // the longest token from `p`: run until the automaton dies,
+            // remembering the last accepting state passed
+            unsigned s = a.start[p == begin? 0 : 1];
+            int rule = automaton::none;
+            char const* last = p;
+            char const* q = p;
+            while (q != end)
+            {
+                s = next[s * nclasses + a.classes[static_cast<unsigned char>(*q++)]];
+                if (s == automaton::dead)
+                    break;
+                if (accepts[s] != automaton::none)
+                {
+                    rule = accepts[s];
+                    last = q;
+                }
+            }
+            if (q == end && s != automaton::dead && a.eot_accepts[s] != automaton::none)
+            {
+                rule = a.eot_accepts[s];
+                last = end;
+            }
+            scanned += q - p;
+
+            if (rule == automaton::none)
+            {
+                if (!out.empty() && out.back().id == unmatched && out.back().offset + out.back().length == size_t(p - begin))
+                    ++out.back().length;
+                else
+                    out.push_back(token { unmatched, 1, size_t(p - begin) });
+                ++p;
+                continue;
+            }
+            out.push_back(token { ids[rule], std::uint32_t(last - p), size_t(p - begin) });
+            ++found;
+            p = last;
+        }
+        if (counters)
+        {
+            counters->bytes += scanned;
+            counters->matches += found;
+        }
+    }
+
+    std::vector<token> scanner::tokenize(std::string const& text, stats::scan* counters) const
+    {
+        std::vector<token> out;
+        tokenize(text.data(), text.data() + text.size(), out, counters);
+        return out;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef __LEXER__
+#define __LEXER__
+
+#include "ast.hpp"
+#include "glushkov.hpp"
+#include "stats.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lexer
+{
+    struct rule
+    {
+        std::uint32_t id; // reported for its tokens
+        ast::regex    tree;
+    };
+
+    struct token
+    {
+        std::uint32_t id;
+        std::uint32_t length;
+        std::size_t   offset;
+    };
+
+    // One DFA for all rules, anchored at the token start. A state accepts
+    // for the first rule (in list order) whose match ends there, so the
+    // earlier rule wins between two of the same length.
+    struct automaton
+    {
+        static unsigned const dead = 0;
+        static int const      none = -1;
+
+        std::array<unsigned char, 256> classes;
+        unsigned                       nclasses;
+        std::vector<unsigned>          next;        // [state * nclasses + class]
+        std::vector<int>               accepts;     // rule index of a token ending before the next byte, or none
+        std::vector<int>               eot_accepts; // the same if the buffer ends here
+
+        // initial state for a token at the start of the buffer, or not
+        unsigned start[2];
+
+        unsigned size() const { return accepts.size(); }
+        unsigned step(unsigned state, unsigned char byte) const {
+            return next[state * nclasses + classes[byte]];
+        }
+    };
+
+    // `rules` are glushkov automata (default options), in priority order
+    automaton determinize(std::vector<glushkov::automaton> const& rules);
+
+    // Maximal munch: at each offset the longest token any rule matches,
+    // the earliest rule among equally long ones. A byte where no token
+    // (of at least one byte) starts is reported as `unmatched`, a run of
+    // them as one token. `^` and `$` hold at the ends of the buffer.
+    struct scanner
+    {
+        static std::uint32_t const unmatched = 0xffffffff;
+
+        std::vector<std::uint32_t> ids; // by rule index
+        automaton                  tokens;
+        stats::compile             compiled;
+
+        explicit scanner(std::vector<rule> const& rules);
+
+        // appends to `out`, which keeps its capacity between calls, so a
+        // reused vector allocates nothing per token or per buffer
+        void tokenize(char const* begin, char const* end, std::vector<token>& out, stats::scan* counters = nullptr) const;
+        std::vector<token> tokenize(std::string const& text, stats::scan* counters = nullptr) const;
+    };
+}
+
+#endif // __LEXER__
@@ -1,10 +1,26 @@
 #include "ast.hpp"
+#include "aho_corasick.hpp"
+#include "approx.hpp"
+#include "batch.hpp"
 #include "parser.hpp"
+#include "dfa.hpp"
+#include "packed.hpp"
+#include "planner.hpp"
+#include "relation.hpp"
+#include "ruleset.hpp"
+#include "flat.hpp"
+#include "lexer.hpp"
+#include "nfa.hpp"
+#include "tdfa.hpp"
+#include "stats.hpp"
+#include <algorithm>
 #include <set>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 #include <functional>
 #include <iostream>
+#include <iterator>
 
 static std::string multiplicity_text(ast::multiplicity const& m) {
     std::ostringstream os;
@@ -54,26 +70,16 @@ struct regex_tostring : boost::static_visitor<>
     regex_tostring(std::ostream& os) : os(os) {}
     ~regex_tostring() { os << "\n"; }
 
-    void operator()(ast::alternative const & a) const {
-        for (size_t i = 0; i<a.size(); ++i)
-        {
-            if (i) os << '|';
-            (*this)(a[i]);
-        }
-    }
-
-    void operator()(ast::atom const & v) const {
-        boost::apply_visitor(*this, v.expr);
-        (*this)(v.mult);
-    }
+    void operator()(ast::alternative const & a) const { walk(&a); }
+    void operator()(ast::atom const & v)        const { walk(&v); }
 
     void operator()(ast::start_of_match    const & v) const { os << '^'; }
     void operator()(ast::end_of_match      const & v) const { os << '$'; }
     void operator()(ast::any_char          const & v) const { os << '.'; }
-    void operator()(ast::group             const & v) const { os << '('; (*this)(v.root); os << ')'; }
+    void operator()(ast::group             const & v) const { os << '('; walk(&v.root); os << ')'; }
     void operator()(char                   const v)   const { escape_into(os, v); }
     void operator()(std::string            const & v) const { escape_into(os, v); }
-    void operator()(std::vector<ast::atom> const & v) const { for(auto& atom : v) (*this)(atom); }
+    void operator()(std::vector<ast::atom> const & v) const { walk(&v); }
     void operator()(ast::multiplicity      const & m) const { os << multiplicity_text(m); }
 
     void operator()(ast::charset           const & v) const {
@@ -87,6 +93,52 @@ struct regex_tostring : boost::static_visitor<>
         escape_into(os, get<0>(v)) << "-";
         escape_into(os, get<1>(v));
     }
+
+  private:
+    // pending work, either a subtree or literal text; kept on a heap stack
+    // so nesting depth doesn't translate into call depth
+    using task = boost::variant<ast::alternative const*, ast::sequence const*, ast::atom const*, std::string>;
+
+    struct expand : boost::static_visitor<>
+    {
+        regex_tostring const& out;
+        std::vector<task>& todo;
+
+        expand(regex_tostring const& out, std::vector<task>& todo) : out(out), todo(todo) {}
+
+        void operator()(ast::alternative const* a) const {
+            for (size_t i = a->size(); i-- > 0;)
+            {
+                todo.push_back(&(*a)[i]);
+                if (i) todo.push_back(std::string("|"));
+            }
+        }
+        void operator()(ast::sequence const* v) const {
+            for (auto it = v->rbegin(); it != v->rend(); ++it)
+                todo.push_back(&*it);
+        }
+        void operator()(ast::atom const* v) const {
+            todo.push_back(multiplicity_text(v->mult));
+            if (auto g = boost::get<ast::group>(&v->expr))
+            {
+                out.os << '(';
+                todo.push_back(std::string(")"));
+                todo.push_back(&g->root);
+            } else
+                boost::apply_visitor(out, v->expr);
+        }
+        void operator()(std::string const& text) const { out.os << text; }
+    };
+
+    void walk(task root) const {
+        std::vector<task> todo(1, root);
+        while (!todo.empty())
+        {
+            task current = std::move(todo.back());
+            todo.pop_back();
+            boost::apply_visitor(expand(*this, todo), current);
+        }
+    }
 };
 
 struct regex_todigraph : boost::static_visitor<std::string>
@@ -171,21 +223,104 @@ struct regex_todigraph : boost::static_visitor<std::string>
         os << "}\n";
     }
 
-  public:
-    std::string operator()(ast::alternative const& a) const {
-        if (a.size()>1)
+    // one sub-expression whose children's nodes are still being emitted;
+    // frames live on a heap stack, children come out before their parent
+    struct frame
+    {
+        boost::variant<ast::alternative const*, ast::sequence const*, ast::group const*> node;
+        ast::multiplicity     mult;
+        size_t                next;     // next child to visit
+        std::set<std::string> children;
+        std::string           last;     // the only child, when passed through
+
+        template <typename T>
+        frame(T const* node, ast::multiplicity mult = {}) : node(node), mult(mult), next(0) {}
+    };
+
+    // pushes the next composite child of the top frame, emitting leaf
+    // children on the way; false when the top frame has no children left
+    bool descend(std::vector<frame>& stack) const {
+        frame& top = stack.back();
+
+        if (auto a = boost::get<ast::alternative const*>(&top.node))
         {
-            std::set<std::string> children;
-            for (auto& branch: a)
-                children.insert((*this)(branch));
+            if (top.next == (*a)->size())
+                return false;
+            stack.push_back(frame(&(**a)[top.next++]));
+            return true;
+        }
+
+        if (auto g = boost::get<ast::group const*>(&top.node))
+        {
+            if (top.next++)
+                return false;
+            stack.push_back(frame(&(*g)->root));
+            return true;
+        }
+
+        auto const& v = *boost::get<ast::sequence const*>(top.node);
+        while (top.next < v.size())
+        {
+            auto& atom = v[top.next++];
+            if (auto g = boost::get<ast::group>(&atom.expr))
+            {
+                stack.push_back(frame(g, atom.mult));
+                return true;
+            }
+            // simplification that hides the 'atom' intermediate node and applies
+            // `multiplicity` decoration directly on the simple node
+            top.last = boost::apply_visitor(std::bind(std::ref(*this), std::placeholders::_1, atom.mult), atom.expr);
+            top.children.insert(top.last);
+        }
+        return false;
+    }
+
+    std::string finish(frame const& f) const {
+        if (auto a = boost::get<ast::alternative const*>(&f.node))
+        {
+            if ((*a)->size() <= 1)
+                return f.last;
 
             std::string const thisnode = emit_node("alternative", diamond());
-            emit_vertices(thisnode, children);
+            emit_vertices(thisnode, f.children);
             return thisnode;
-        } else
+        }
+
+        if (boost::get<ast::group const*>(&f.node))
         {
-            return (*this)(a[0]);
+            std::string const thisnode = emit_node("group", f.mult);
+            emit_vertices(thisnode, f.children);
+            return thisnode;
         }
+
+        if (boost::get<ast::sequence const*>(f.node)->size() <= 1)
+            return f.last;
+
+        std::string const thisnode = emit_node("sequence", f.mult, sequence());
+        emit_vertices(thisnode, f.children);
+        return thisnode;
+    }
+
+    std::string walk(frame root) const {
+        std::vector<frame> stack(1, root);
+        while (true)
+        {
+            if (descend(stack))
+                continue;
+
+            std::string const thisnode = finish(stack.back());
+            stack.pop_back();
+            if (stack.empty())
+                return thisnode;
+
+            stack.back().children.insert(thisnode);
+            stack.back().last = thisnode;
+        }
+    }
+
+  public:
+    std::string operator()(ast::alternative const& a) const {
+        return walk(frame(&a));
     }
 
     std::string operator()(ast::start_of_match const& v, ast::multiplicity mult = {}) const {
@@ -198,13 +333,7 @@ struct regex_todigraph : boost::static_visitor<std::string>
         return emit_node("any", mult, special());
     }
     std::string operator()(ast::group const& v, ast::multiplicity mult = {}) const {
-        {
-            auto child = (*this)(v.root);
-
-            std::string const thisnode = emit_node("group", mult);
-            emit_vertices(thisnode, { child });
-            return thisnode;
-        }
+        return walk(frame(&v, mult));
     }
 
     std::string operator()(ast::charset const& v, ast::multiplicity mult = {}) const {
@@ -245,22 +374,7 @@ struct regex_todigraph : boost::static_visitor<std::string>
     }
 
     std::string operator()(std::vector<ast::atom> const& v, ast::multiplicity mult = {}) const {
-        if (v.size()>1)
-        {
-            std::set<std::string> children;
-            for (auto& atom: v)
-                children.insert((*this)(atom));
-
-            std::string const thisnode = emit_node("sequence", mult, sequence());
-            emit_vertices(thisnode, children);
-            return thisnode;
-        } else
-        {
-            for (auto& atom: v)
-                return (*this)(atom);
-        }
-
-        return "";
+        return walk(frame(&v, mult));
     }
 
     std::string operator()(ast::atom const& atom) const {
@@ -290,12 +404,612 @@ void check_roundtrip(ast::regex tree, std::string input)
 
     if (os.str() != input)
         std::cerr << "WARNING: '" << input << "' -> '" << os.str() << "'\n";
+
+    // the flat form must give back the same tree
+    ast::regex unflattened = flat::to_ast(flat::from_ast(tree));
+    std::ostringstream flat_os;
+    regex_tostring flat_str(flat_os);
+
+    boost::apply_visitor(flat_str, unflattened);
+
+    if (flat_os.str() != os.str())
+        std::cerr << "WARNING: '" << input << "' flattened -> '" << flat_os.str() << "'\n";
+}
+
+// packed with no room for dense rows, so the comb and the exception
+// lists are exercised; every transition must come out as in the full table
+void check_packed(dfa::automaton const& a, std::string const& pattern)
+{
+    packed::options opts;
+    opts.dense_bytes  = 0;
+    opts.sparse_limit = 1;
+    packed::table const t = packed::pack(a, opts);
+
+    for (unsigned s = 0; s < a.size(); ++s)
+        for (unsigned b = 0; b < 256; ++b)
+            if (t.step(s, b) != a.step(s, b))
+            {
+                std::cerr << "WARNING: '" << pattern << "' packed state " << s << " byte " << b << " differs\n";
+                return;
+            }
+
+    std::cout << "// packed " << t.count(packed::encoding::comb) << " comb and " << t.count(packed::encoding::sparse)
+              << " sparse rows, " << t.bytes() << " bytes\n";
+}
+
+// Counted repeats inside other loops: the counted simulation must agree
+// with the same pattern unrolled, on runs of x's long enough to need
+// several iterations of the outer loop.
+void check_counted()
+{
+    for (std::string pattern: {
+            "(x{1,20})*",
+            "(x{2,20})+",
+            "(x{5,17})*y",
+            "(x{17,20}|y)*",
+            "(x{3,20}y?)*",
+        })
+    {
+        ast::regex tree;
+        if (!doParse(pattern, tree))
+        {
+            std::cerr << "WARNING: '" << pattern << "' doesn't parse\n";
+            continue;
+        }
+        nfa::matcher const counted(tree, 16), unrolled(tree, 0);
+
+        unsigned wrong = 0;
+        for (unsigned n = 0; n <= 64; ++n)
+            for (std::string tail: { "", "y", "yx", "xy", "yy" })
+            {
+                std::string const text = std::string(n, 'x') + tail;
+                wrong += counted.matches(text) != unrolled.matches(text);
+                wrong += counted.search(text) != unrolled.search(text);
+            }
+        if (wrong)
+            std::cerr << "WARNING: '" << pattern << "' counted and unrolled disagree on " << wrong << " inputs\n";
+    }
+}
+
+// Maximal munch over a few rules: the longest token wins, the earlier
+// rule among equally long ones ("if" is a keyword, "iffy" a name), and
+// bytes no rule starts with merge into one unmatched token.
+void check_lexer()
+{
+    std::vector<std::pair<std::uint32_t, std::string>> const patterns {
+        { 1, "if" }, { 2, "[a-z]+" }, { 3, "[0-9]+" }, { 4, " +" }, { 5, "==|=" },
+    };
+    std::vector<lexer::rule> rules;
+    for (auto& p : patterns)
+    {
+        rules.push_back({ p.first, ast::regex() });
+        if (!doParse(p.second, rules.back().tree))
+            std::cerr << "WARNING: lexer rule '" << p.second << "' doesn't parse\n";
+    }
+    lexer::scanner const scan(rules);
+
+    std::uint32_t const none = lexer::scanner::unmatched;
+    std::vector<lexer::token> const expected {
+        { 1, 2, 0 }, { 4, 1, 2 }, { 2, 4, 3 }, { 4, 1, 7 }, { 5, 2, 8 }, { 4, 1, 10 },
+        { 3, 2, 11 }, { 4, 1, 13 }, { none, 3, 14 }, { 2, 1, 17 }, { 5, 1, 18 }, { none, 1, 19 },
+    };
+    auto const found = scan.tokenize("if iffy == 42 #?#x=!");
+
+    bool same = found.size() == expected.size();
+    for (size_t i = 0; same && i < found.size(); ++i)
+        same = found[i].id == expected[i].id && found[i].length == expected[i].length && found[i].offset == expected[i].offset;
+    if (!same)
+    {
+        std::cerr << "WARNING: lexer tokens differ:";
+        for (auto& t : found)
+            std::cerr << " (" << int(t.id) << "," << t.offset << "," << t.length << ")";
+        std::cerr << "\n";
+    }
+}
+
+// A rule set edited between two commits, two rules to a shard: a reader
+// holding the first version keeps its results while the next is staged
+// and after it is published.
+void check_ruleset()
+{
+    auto matching = [](ruleset::version const& v, std::string const& text) {
+        return v.matching(text.data(), text.data() + text.size());
+    };
+    auto expect = [&](char const* when, ruleset::version const& v, std::string const& text, std::vector<std::uint32_t> const& ids) {
+        if (matching(v, text) != ids)
+            std::cerr << "WARNING: rule set " << when << ": wrong rules match '" << text << "'\n";
+    };
+
+    ruleset::set rules(2);
+    rules.add(1, "abc");
+    rules.add(2, "^x");
+    rules.add(3, "[0-9]+$");
+    rules.add(4, "zz");
+    rules.commit();
+    auto const first = rules.current();
+    expect("first", *first, "abc 42", { 1, 3 });
+    expect("first", *first, "xabczz", { 1, 2, 4 });
+
+    if (rules.add(5, "[") || rules.remove(99))
+        std::cerr << "WARNING: rule set: a bad pattern or unknown id was accepted\n";
+    rules.remove(1);
+    rules.add(2, "q"); // replaces
+    rules.add(5, "c");
+    expect("staged", *rules.current(), "abc 42", { 1, 3 });
+
+    rules.commit();
+    expect("second", *rules.current(), "abc 42", { 3, 5 });
+    expect("second", *rules.current(), "xabczzq", { 2, 4, 5 });
+    expect("first, kept", *first, "abc 42", { 1, 3 });
+}
+
+// Approximate search: where the first match with at most k edits ends,
+// and its fewest edits, worked out by hand. A shorter match with more
+// edits ends first ("hell" in "say hello"); anchors count the bytes
+// outside them as edits.
+void check_approx()
+{
+    struct expectation
+    {
+        char const* pattern;
+        unsigned    k;
+        char const* text;
+        int         end, errors; // end -1: no match
+    };
+    for (auto& e : std::vector<expectation> {
+            { "hello",    1, "say hello", 8, 1 },
+            { "hello",    1, "help",     -1, 0 },
+            { "hello",    2, "help",      3, 2 },
+            { "hello",    1, "jello",     5, 1 },
+            { "^ab$",     1, "abc",       3, 1 },
+            { "^ab$",     1, "xabc",     -1, 0 },
+            { "a[0-9]+b", 0, "xa12b",     5, 0 },
+            { "a[0-9]+b", 0, "xab",      -1, 0 },
+            { "a[0-9]+b", 1, "xab",       3, 1 },
+        })
+    {
+        ast::regex tree;
+        if (!doParse(e.pattern, tree))
+        {
+            std::cerr << "WARNING: '" << e.pattern << "' doesn't parse\n";
+            continue;
+        }
+        std::string const text = e.text;
+        auto const hit = approx::matcher(tree, e.k).find(text.data(), text.data() + text.size());
+        if (hit? e.end != int(hit->end) || e.errors != int(hit->errors) : e.end != -1)
+            std::cerr << "WARNING: '" << e.pattern << "' with " << e.k << " edits in '" << e.text << "': "
+                      << (hit? std::to_string(hit->end) + "," + std::to_string(hit->errors) : std::string("none")) << "\n";
+    }
+}
+
+// `$^` holds only where nothing was read: on the empty text, and in
+// line mode on every empty line. Every engine must agree.
+void check_empty_text()
+{
+    ast::regex tree;
+    if (!doParse("$^", tree))
+    {
+        std::cerr << "WARNING: '$^' doesn't parse\n";
+        return;
+    }
+    dfa::matcher const forward(tree);
+    auto const hit = forward.find("");
+    if (!hit || hit->begin != 0 || hit->end != 0 || forward.find("a"))
+        std::cerr << "WARNING: '$^': dfa finds the wrong match\n";
+    if (!tdfa::matcher(tree).find("") || tdfa::matcher(tree).find("a"))
+        std::cerr << "WARNING: '$^': tdfa finds the wrong match\n";
+    nfa::matcher const sim(tree);
+    if (!sim.matches("") || !sim.search("") || sim.search("a"))
+        std::cerr << "WARNING: '$^': nfa finds the wrong match\n";
+
+    ruleset::set rules(1);
+    rules.add(1, "$^");
+    rules.commit();
+    std::string const empty;
+    if (rules.current()->matching(empty.data(), empty.data()) != std::vector<std::uint32_t> { 1 })
+        std::cerr << "WARNING: '$^': the rule set misses the empty text\n";
+
+    std::vector<size_t> lines;
+    for (auto& m : forward.match_lines("a\n\nb\n\n"))
+        lines.push_back(m.number);
+    if (lines != std::vector<size_t> { 1, 3 })
+        std::cerr << "WARNING: '$^': wrong empty lines\n";
+}
+
+// Sub-matches, worked out by hand, "-" for a group that didn't take
+// part. The tagged DFA's group 0 must be the plain DFA's match, also
+// where a loop's body matches empty.
+void check_captures()
+{
+    struct expectation
+    {
+        char const* pattern;
+        char const* text;
+        char const* groups;
+    };
+    for (auto& e : std::vector<expectation> {
+            { "(a+)(b+)?",  "xaab",  "[1,4) [1,3) [3,4)" },
+            { "(a+)(b+)?",  "xaa",   "[1,3) [1,3) -" },
+            { "(a|ab)(c)",  "abc",   "[0,3) [0,2) [2,3)" },
+            { "(a)*b",      "aab",   "[0,3) [1,2)" },
+            { "(a*)*",      "aa",    "[0,2) [2,2)" },
+            { "(b*?)*",     "b",     "[0,0) [0,0)" },
+            { "b?(b*?)+",   "bba",   "[0,1) [1,1)" },
+            { "(a|b*?)*",   "ab",    "[0,1) [1,1)" },
+            { "(a(b*?))*",  "aab",   "[0,2) [1,2) [2,2)" },
+        })
+    {
+        ast::regex tree;
+        if (!doParse(e.pattern, tree))
+        {
+            std::cerr << "WARNING: '" << e.pattern << "' doesn't parse\n";
+            continue;
+        }
+        std::string const text = e.text;
+        auto const found = tdfa::matcher(tree).find(text);
+        auto const whole = dfa::matcher(tree).find(text);
+
+        std::ostringstream groups;
+        if (found)
+            for (auto& g : *found)
+                groups << (&g == &found->front()? "" : " ") << (g? "[" + std::to_string(g->begin) + "," + std::to_string(g->end) + ")" : "-");
+        if (groups.str() != e.groups)
+            std::cerr << "WARNING: '" << e.pattern << "' on '" << e.text << "' captures " << groups.str() << "\n";
+        if (!found || !whole || !(*found)[0] || (*found)[0]->begin != whole->begin || (*found)[0]->end != whole->end)
+            std::cerr << "WARNING: '" << e.pattern << "' on '" << e.text << "': tdfa and dfa matches differ\n";
+    }
+}
+
+// Case-insensitive matching on mixed-case text: literals and sets match
+// either case, and a negated set excludes both.
+void check_icase()
+{
+    struct expectation
+    {
+        char const* pattern;
+        char const* text;
+        char const* spans; // find_all
+    };
+    for (auto& e : std::vector<expectation> {
+            { "abc",     "xAbC abc ABC", "[1,4) [5,8) [9,12)" },
+            { "[a-c]+",  "xyBaCd",       "[2,5)" },
+            { "[^a]+",   "bAaAb",        "[0,1) [4,5)" },
+            { "Hello!",  "HELLO! hello", "[0,6)" },
+            { "x[0-9]Y", "X1y x2Y xay",  "[0,3) [4,7)" },
+        })
+    {
+        ast::regex tree;
+        if (!doParse(e.pattern, tree))
+        {
+            std::cerr << "WARNING: '" << e.pattern << "' doesn't parse\n";
+            continue;
+        }
+        std::ostringstream spans;
+        for (auto& m : dfa::matcher(tree, dfa::match_kind::leftmost_first, true).find_all(e.text))
+            spans << (spans.tellp()? " " : "") << "[" << m.begin << "," << m.end << ")";
+        if (spans.str() != e.spans)
+            std::cerr << "WARNING: '" << e.pattern << "' ignoring case in '" << e.text << "': " << spans.str() << "\n";
+    }
+}
+
+// The pool must report what a search of each input on its own does,
+// however the inputs are cut into batches, down to batches smaller than
+// one line. dfa::matcher is handed whole batches, nfa::matcher searches
+// one input at a time.
+void check_batch()
+{
+    std::string const text = "abc\n\nxxabx\nab\n" + std::string(300, 'x') + "\nabab\nb\na\nzzzzzzzzab\n";
+    auto const inputs = batch::lines(text);
+    batch::pool workers(3);
+
+    ast::regex tree;
+    if (!doParse("ab|^$", tree))
+    {
+        std::cerr << "WARNING: 'ab|^$' doesn't parse\n";
+        return;
+    }
+    dfa::matcher const forward(tree);
+    nfa::matcher const sim(tree);
+
+    std::vector<char> expected;
+    for (auto& in : inputs)
+        expected.push_back(forward.search(in.begin, in.end));
+    size_t const total = std::count(expected.begin(), expected.end(), 1);
+    if (total != 6)
+        std::cerr << "WARNING: batch: " << total << " lines match one at a time\n";
+
+    for (size_t batch_bytes : { size_t(1), size_t(5), size_t(64), batch::default_batch_bytes })
+    {
+        if (batch::matches(forward, inputs, workers, nullptr, batch_bytes) != expected
+                || batch::count(forward, inputs, workers, nullptr, batch_bytes) != total)
+            std::cerr << "WARNING: batch of " << batch_bytes << " bytes: dfa differs from one search per line\n";
+        if (batch::matches(sim, inputs, workers, nullptr, batch_bytes) != expected
+                || batch::count(sim, inputs, workers, nullptr, batch_bytes) != total)
+            std::cerr << "WARNING: batch of " << batch_bytes << " bytes: nfa differs from one search per line\n";
+    }
+}
+
+// Line mode: '^' and '$' hold at every line's ends, an empty line is a
+// line, and a final newline starts no other one.
+void check_lines()
+{
+    std::string const text = "ab\nxab\n\nabx\nab\n";
+    struct expectation
+    {
+        char const*         pattern;
+        std::vector<size_t> lines;
+    };
+    for (auto& e : std::vector<expectation> {
+            { "ab",   { 0, 1, 3, 4 } },
+            { "^ab",  { 0, 3, 4 } },
+            { "ab$",  { 0, 1, 4 } },
+            { "^ab$", { 0, 4 } },
+            { "^$",   { 2 } },
+            { "x",    { 1, 3 } },
+            { "^",    { 0, 1, 2, 3, 4 } },
+        })
+    {
+        ast::regex tree;
+        if (!doParse(e.pattern, tree))
+        {
+            std::cerr << "WARNING: '" << e.pattern << "' doesn't parse\n";
+            continue;
+        }
+        dfa::matcher const m(tree);
+        std::vector<size_t> lines;
+        for (auto& found : m.match_lines(text))
+            lines.push_back(found.number);
+        if (lines != e.lines || m.count_lines(text) != e.lines.size())
+            std::cerr << "WARNING: '" << e.pattern << "' matches the wrong lines\n";
+    }
+}
+
+// Keyword sets: Aho-Corasick must find what the DFA finds for the same
+// alternation, where keywords overlap ("she" and "he" in "ushers") and
+// where one is a prefix of another, listed before or after it.
+void check_keywords()
+{
+    std::string const text = "ushers his abcd XYZ123 abab d abd acd hisher";
+    for (std::string pattern: {
+            "abc|d",
+            "(XYZ)|(123)",
+            "he|she|his|hers",
+            "ab|abc",
+            "abc|ab",
+            "a(b|c)d",
+        })
+    {
+        ast::regex tree;
+        if (!doParse(pattern, tree))
+        {
+            std::cerr << "WARNING: '" << pattern << "' doesn't parse\n";
+            continue;
+        }
+        auto const keywords = aho_corasick::literals(tree);
+        if (!keywords)
+        {
+            std::cerr << "WARNING: '" << pattern << "' has no keywords\n";
+            continue;
+        }
+        auto const expected = dfa::matcher(tree).find_all(text);
+        auto const found    = aho_corasick::matcher(*keywords).find_all(text);
+
+        bool same = found.size() == expected.size();
+        for (size_t i = 0; same && i < found.size(); ++i)
+            same = found[i].begin == expected[i].begin && found[i].end == expected[i].end;
+        if (!same)
+            std::cerr << "WARNING: '" << pattern << "': aho-corasick and dfa find different matches\n";
+    }
+}
+
+// A large repeat is counted for the NFA but probed unrolled, so a DFA
+// blowup behind it is still seen; finding spans on an NFA plan throws.
+void check_planner()
+{
+    ast::regex tree;
+    if (!doParse("[ab]*a[ab]{17}", tree))
+    {
+        std::cerr << "WARNING: '[ab]*a[ab]{17}' doesn't parse\n";
+        return;
+    }
+    auto const spans = planner::analyze(tree);
+    if (spans.chosen != planner::engine::dfa || !spans.pattern.explodes || spans.pattern.largest_repeat != 17)
+        std::cerr << "WARNING: '[ab]*a[ab]{17}' planned without its DFA blowup\n";
+
+    planner::options search;
+    search.wanted = planner::goal::search;
+    planner::matcher const m(tree, search);
+    std::string const text = "ab";
+    try
+    {
+        m.find(text.data(), text.data() + text.size(), text.data());
+        std::cerr << "WARNING: spans from an NFA plan\n";
+    } catch (std::logic_error const&)
+    {
+    }
+}
+
+// The interleaved search steps four inputs at a time; each must come out
+// as when searched alone, with inputs of uneven lengths (empty ones, and
+// matches early, late and nowhere) and more of them than lanes.
+void check_lanes()
+{
+    std::vector<std::string> texts;
+    for (unsigned i = 0; i < 23; ++i)
+    {
+        std::string t(i * 7 % 31, 'x');
+        if (i % 3 == 0)
+            t.insert(i % 2? 0 : t.size(), "ab");
+        if (i % 5 == 0)
+            t += 'c';
+        texts.push_back(t);
+    }
+    std::vector<util::slice> inputs;
+    for (auto& t : texts)
+        inputs.push_back({ t.data(), t.data() + t.size() });
+
+    for (std::string pattern: { "ab", "^x*c$", "x{5}ab|c", "^$" })
+    {
+        ast::regex tree;
+        if (!doParse(pattern, tree))
+        {
+            std::cerr << "WARNING: '" << pattern << "' doesn't parse\n";
+            continue;
+        }
+        dfa::matcher const m(tree);
+        for (size_t count : { size_t(1), size_t(3), size_t(4), size_t(5), inputs.size() })
+        {
+            std::vector<char> found(count);
+            m.search(inputs.data(), count, found.data());
+            for (size_t i = 0; i < count; ++i)
+                if (bool(found[i]) != m.search(inputs[i].begin, inputs[i].end))
+                {
+                    std::cerr << "WARNING: '" << pattern << "' searching " << count << " inputs: lane result " << i << " differs\n";
+                    break;
+                }
+        }
+    }
+}
+
+// Determinization on a pool must give the serial automaton, state ids
+// included, also past one round of the parallel build (4096 states);
+// both must accept the same texts.
+void check_parallel()
+{
+    batch::pool workers(3);
+    auto accepts = [](dfa::automaton const& a, std::string const& text) {
+        unsigned s = a.start[0];
+        for (char c : text)
+            s = a.step(s, c);
+        return bool(a.eot_accepting[s]);
+    };
+    std::vector<std::string> texts { "", "a", "ab", "abc", "abab", "xyz123" };
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        std::string t;
+        for (unsigned n = i; n; n /= 3)
+            t += "abc"[n % 3];
+        texts.push_back(t + std::string(i % 14, 'b'));
+    }
+
+    for (std::string pattern: { "ab+c", "(ab)+c|b*", ".*?(a|b){,9}?", "[ab]*a[ab]{12}" })
+    {
+        ast::regex tree;
+        if (!doParse(pattern, tree))
+        {
+            std::cerr << "WARNING: '" << pattern << "' doesn't parse\n";
+            continue;
+        }
+        auto const fa = glushkov::build(tree);
+        for (bool unanchored : { false, true })
+        {
+            auto const serial   = dfa::determinize(fa, dfa::match_kind::leftmost_first, unanchored);
+            auto const parallel = dfa::determinize(fa, dfa::match_kind::leftmost_first, unanchored, workers);
+            if (serial.size() != parallel.size() || serial.next != parallel.next || serial.eot_accepting != parallel.eot_accepting)
+                std::cerr << "WARNING: '" << pattern << "': " << serial.size() << " states serially, " << parallel.size() << " in parallel\n";
+            for (auto& t : texts)
+                if (accepts(serial, t) != accepts(parallel, t))
+                {
+                    std::cerr << "WARNING: '" << pattern << "': serial and parallel DFAs differ on '" << t << "'\n";
+                    break;
+                }
+        }
+    }
+}
+
+// Pattern relations in both scopes, worked out by hand: '=' equivalent,
+// '<' the first matches less than the second, '>' more, 'x' they overlap
+// and neither contains the other, '0' disjoint. Every witness text must
+// be matched as its field says, by dfa::matcher rather than the product
+// walk that found it.
+void check_relations()
+{
+    struct expectation
+    {
+        char const* first;
+        char const* second;
+        char        whole, anywhere;
+    };
+    auto parse = [](std::string const& pattern, ast::regex& tree) {
+        if (doParse(pattern, tree))
+            return true;
+        std::cerr << "WARNING: '" << pattern << "' doesn't parse\n";
+        return false;
+    };
+    auto matched = [](ast::regex const& anchored, ast::regex const& tree, relation::scope where, std::string const& text) {
+        return bool(dfa::matcher(where == relation::scope::whole_text? anchored : tree).find(text));
+    };
+
+    for (auto& e : std::vector<expectation> {
+            { "a|b",  "[ab]", '=', '=' },
+            { "a+",   "aa*",  '=', '=' },
+            { "ab",   "a.*",  '<', '<' },
+            { "a.*",  "ab",   '>', '>' },
+            { "ab",   "b",    '0', '<' },
+            { "a[bc]", "[ab]c", 'x', 'x' },
+            { "abc",  "x",    '0', 'x' },
+        })
+    {
+        ast::regex trees[2], anchored[2];
+        if (!parse(e.first, trees[0]) || !parse(e.second, trees[1])
+                || !parse(std::string("^(") + e.first + ")$", anchored[0]) || !parse(std::string("^(") + e.second + ")$", anchored[1]))
+            continue;
+
+        for (auto where : { relation::scope::whole_text, relation::scope::anywhere })
+        {
+            char const* const scope = where == relation::scope::whole_text? "whole text" : "anywhere";
+            auto const c = relation::compare(relation::language(trees[0], where), relation::language(trees[1], where), where);
+
+            char const expected = where == relation::scope::whole_text? e.whole : e.anywhere;
+            char const found = c.equivalent()? '=' : c.first_in_second()? '<' : c.second_in_first()? '>' : c.intersect()? 'x' : '0';
+            if (found != expected)
+                std::cerr << "WARNING: '" << e.first << "' " << found << " '" << e.second << "' " << scope << ", expected " << expected << "\n";
+
+            auto witness = [&](boost::optional<std::string> const& text, bool in_first, bool in_second, char const* field) {
+                if (text && (matched(anchored[0], trees[0], where, *text) != in_first || matched(anchored[1], trees[1], where, *text) != in_second))
+                    std::cerr << "WARNING: '" << e.first << "', '" << e.second << "' " << scope << ": " << field << " '" << *text << "' is wrong\n";
+            };
+            witness(c.only_first, true, false, "only_first");
+            witness(c.only_second, false, true, "only_second");
+            witness(c.both, true, true, "both");
+        }
+    }
+
+    // [ab] is a|b again and ab is in a.*; the first of equivalents stays
+    std::vector<dfa::automaton> rules;
+    for (std::string pattern: { "a|b", "[ab]", "ab", "a.*" })
+    {
+        ast::regex tree;
+        if (!parse(pattern, tree))
+            return;
+        rules.push_back(relation::language(tree, relation::scope::whole_text));
+    }
+    auto const found = relation::redundant(rules, relation::scope::whole_text);
+    if (found.size() != 2 || found[0].rule != 1 || found[0].kept != 0 || !found[0].equivalent
+            || found[1].rule != 2 || found[1].kept != 3 || found[1].equivalent)
+        std::cerr << "WARNING: wrong redundant rules among a|b, [ab], ab, a.*\n";
+}
+
+// the pattern as regex_tostring spells it, without the newline
+static std::string canonical(ast::regex const& tree)
+{
+    std::ostringstream os;
+    {
+        regex_tostring str(os);
+        boost::apply_visitor(str, tree);
+    }
+    std::string text = os.str();
+    text.pop_back();
+    return text;
 }
 
 int main()
 {
     std::cout << "digraph common {\n";
 
+    std::vector<dfa::automaton> languages; // whole-text, for relation::redundant
+    std::vector<std::string>    labels;
+
     for (std::string pattern: {
             "abc?",
             "ab+c",
@@ -310,14 +1024,50 @@ int main()
     {
         std::cout << "// ================= " << pattern << " ========\n";
         ast::regex tree;
+        stats::stopwatch timer;
         if (doParse(pattern, tree))
         {
+            double const parse_time = timer.lap();
             check_roundtrip(tree, pattern);
 
+            dfa::matcher compiled(tree);
+            compiled.compiled.time.parse = parse_time;
+            std::cout << "// stats ";
+            stats::write_json(std::cout, compiled.compiled) << "\n";
+            std::cout << "// plan ";
+            planner::write_json(std::cout, planner::analyze(tree)) << "\n";
+            check_packed(compiled.forward, pattern);
+
+            languages.push_back(relation::language(tree, relation::scope::whole_text));
+            labels.push_back(canonical(tree));
+
             regex_todigraph printer(std::cout, pattern);
             boost::apply_visitor(printer, tree);
+#ifdef DFA_PROFILE
+            // the forward automaton as a sample text exercised it
+            compiled.find_all("abcab abbbc ababc d XYZ 123 -ab aaaa- ccc");
+            dfa::write_heatmap(std::cout, compiled.forward, compiled.forward_hits.merged(), "forward DFA");
+#endif
         }
     }
 
+    for (auto r : relation::redundant(languages, relation::scope::whole_text))
+        std::cout << "// redundant '" << labels[r.rule] << "' within '" << labels[r.kept] << "'" << (r.equivalent? " (equivalent)" : "") << "\n";
+
+    check_counted();
+    check_lexer();
+    check_ruleset();
+    check_approx();
+    check_empty_text();
+    check_captures();
+    check_icase();
+    check_batch();
+    check_lines();
+    check_keywords();
+    check_planner();
+    check_lanes();
+    check_parallel();
+    check_relations();
+
     std::cout << "}\n";
 }
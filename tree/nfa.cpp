@@ -0,0 +1,228 @@
+#include "nfa.hpp"
+#include "sparse_set.hpp"
+#include <deque>
+#include <vector>
+
+namespace nfa
+{
+    namespace
+    {
+        using glushkov::symbol_kind;
+
+        // iteration counts of the threads on one counted position, oldest
+        // (largest) first; a value is `shift - entry`, so incrementing all
+        // of them is `++shift`
+        struct counting_set
+        {
+            std::deque<unsigned> entries;
+            unsigned             shift = 0;
+
+            bool     empty()   const { return entries.empty(); }
+            unsigned largest() const { return shift - entries.front(); }
+            void     clear()         { entries.clear(); }
+
+            void add_one(unsigned min) {
+                if (!entries.empty() && shift - entries.back() == 1)
+                    return;
+                entries.push_back(shift - 1);
+                prune(min);
+            }
+
+            void increment(unsigned min, unsigned max) {
+                ++shift;
+                while (!entries.empty() && largest() > max)
+                    entries.pop_front();
+                prune(min);
+            }
+
+            // an older value is redundant once a newer one may exit too: the
+            // newer one can do everything it can and survives longer
+            void prune(unsigned min) {
+                while (entries.size() > 1 && shift - entries[1] >= min)
+                    entries.pop_front();
+            }
+        };
+
+        struct simulation
+        {
+            glushkov::automaton const& fa;
+
+            util::sparse_set          live, next; // positions expecting the next byte
+            std::vector<counting_set> counts;
+            std::vector<char>         may_exit;
+            bool                      matched = false;
+
+            simulation(glushkov::automaton const& fa)
+                : fa(fa), live(fa.positions.size()), next(fa.positions.size()), counts(fa.positions.size()), may_exit(fa.positions.size())
+            { }
+
+            bool activate(unsigned p) {
+                return next.insert(p);
+            }
+
+            void enter(unsigned p, bool at_begin) {
+                auto const& pos = fa.positions[p];
+                switch (pos.kind)
+                {
+                    case symbol_kind::begin_assert:
+                        if (at_begin && next.insert(p))
+                            for (auto q : fa.follow[p])
+                                enter(q, at_begin);
+                        return;
+                    case symbol_kind::accept:
+                        matched = true;
+                        break;
+                    default:
+                        break;
+                }
+                if (pos.counted())
+                    counts[p].add_one(pos.min_count);
+                activate(p);
+            }
+
+            void start(bool at_begin) {
+                for (auto q : fa.first)
+                    enter(q, at_begin);
+            }
+
+            void flip() {
+                live.swap(next);
+                next.clear();
+            }
+
+            void step(unsigned char byte, bool restart) {
+                // counted positions first: exits see the values before this
+                // iteration, loops the ones after it
+                for (auto p : live)
+                {
+                    auto const& pos = fa.positions[p];
+                    if (!pos.counted())
+                        continue;
+                    if (pos.chars.test(byte))
+                    {
+                        may_exit[p] = counts[p].largest() >= pos.min_count;
+                        counts[p].increment(pos.min_count, pos.max_count);
+                    } else
+                    {
+                        may_exit[p] = false;
+                        counts[p].clear();
+                    }
+                }
+
+                for (auto p : live)
+                {
+                    auto const& pos = fa.positions[p];
+                    if (pos.kind != symbol_kind::byte || !pos.chars.test(byte))
+                        continue;
+
+                    // a counted position's own loop is implicit; `p` in its
+                    // follow is a fresh iteration of an enclosing loop
+                    if (pos.counted() && !counts[p].empty())
+                        activate(p);
+                    if (!pos.counted() || may_exit[p])
+                        for (auto q : fa.follow[p])
+                            enter(q, false);
+                }
+
+                if (restart)
+                    start(false);
+                flip();
+            }
+
+            // whether pending end assertions lead to '#' once the text ends;
+            // `at_begin` if nothing was read, so begin assertions pass too
+            bool accepts_at_end(bool at_begin) const {
+                std::vector<char> visited(fa.positions.size());
+                std::vector<unsigned> todo;
+                for (auto p : live)
+                    if (fa.positions[p].kind != symbol_kind::byte)
+                        todo.push_back(p);
+
+                while (!todo.empty())
+                {
+                    unsigned const p = todo.back();
+                    todo.pop_back();
+                    if (visited[p])
+                        continue;
+                    visited[p] = 1;
+
+                    switch (fa.positions[p].kind)
+                    {
+                        case symbol_kind::accept:     return true;
+                        case symbol_kind::begin_assert:
+                            if (at_begin)
+                                todo.insert(todo.end(), fa.follow[p].begin(), fa.follow[p].end());
+                            break;
+                        case symbol_kind::end_assert: todo.insert(todo.end(), fa.follow[p].begin(), fa.follow[p].end()); break;
+                        default:                      break;
+                    }
+                }
+                return false;
+            }
+        };
+
+        glushkov::options counting(unsigned count_above, bool icase)
+        {
+            glushkov::options opts;
+            opts.count_above = count_above;
+            opts.icase       = icase;
+            return opts;
+        }
+    }
+
+    matcher::matcher(ast::regex const& tree, unsigned count_above, bool icase)
+    {
+        stats::stopwatch timer;
+        fa = glushkov::build(tree, counting(count_above, icase));
+        compiled.time.positions = timer.lap();
+        compiled.positions = fa.positions.size();
+    }
+
+    bool matcher::matches(char const* begin, char const* end, stats::scan* counters) const
+    {
+        simulation sim(fa);
+        sim.start(true);
+        sim.flip();
+
+        char const* p = begin;
+        for (; p != end && !sim.live.empty(); ++p)
+            sim.step(*p, false);
+
+        bool const matched = p == end && sim.accepts_at_end(begin == end);
+        if (counters)
+        {
+            counters->bytes += p - begin;
+            counters->matches += matched;
+        }
+        return matched;
+    }
+
+    bool matcher::search(char const* begin, char const* end, stats::scan* counters) const
+    {
+        simulation sim(fa);
+        sim.start(true);
+        sim.flip();
+
+        char const* p = begin;
+        for (; p != end && !sim.matched; ++p)
+            sim.step(*p, true);
+
+        bool const matched = sim.matched || sim.accepts_at_end(begin == end);
+        if (counters)
+        {
+            counters->bytes += p - begin;
+            counters->matches += matched;
+        }
+        return matched;
+    }
+
+    bool matcher::matches(std::string const& text) const
+    {
+        return matches(text.data(), text.data() + text.size());
+    }
+
+    bool matcher::search(std::string const& text) const
+    {
+        return search(text.data(), text.data() + text.size());
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef __NFA__
+#define __NFA__
+
+#include "ast.hpp"
+#include "glushkov.hpp"
+#include "stats.hpp"
+#include <string>
+
+namespace nfa
+{
+    // Position-set simulation of a glushkov automaton, one step per byte.
+    //
+    // Large bounded repeats of a single position stay counted instead of
+    // unrolled. All threads sitting on a counted position advance in
+    // lockstep, so their iteration counts form a counting set: offsets
+    // against a shared step count, pruned to the values that can still make
+    // a difference (at most one value >= min, plus the ones below it). A
+    // deterministic `[0-9]{1,1000}` costs one counter, not 1000 positions.
+    struct matcher
+    {
+        glushkov::automaton fa;
+        stats::compile      compiled;
+
+        explicit matcher(ast::regex const& tree, unsigned count_above = 16, bool icase = false);
+
+        // whether the whole text matches (validation)
+        bool matches(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+        bool matches(std::string const& text) const;
+
+        // whether some part of the text matches
+        bool search(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+        bool search(std::string const& text) const;
+    };
+}
+
+#endif // __NFA__
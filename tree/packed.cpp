@@ -0,0 +1,151 @@
+#include "packed.hpp"
+#include "dfa.hpp"
+#include <map>
+
+namespace packed
+{
+    std::uint32_t const table::unowned;
+
+    namespace
+    {
+        // the target most classes of the row go to, and how many don't
+        std::pair<std::uint32_t, unsigned> most_common(unsigned const* row, unsigned nclasses)
+        {
+            std::map<unsigned, unsigned> tally;
+            std::pair<std::uint32_t, unsigned> best(row[0], 0);
+            for (unsigned c = 0; c < nclasses; ++c)
+                if (++tally[row[c]] > best.second)
+                    best = std::make_pair(row[c], tally[row[c]]);
+            return std::make_pair(best.first, nclasses - best.second);
+        }
+
+        // first fit from the lowest free slot; grows the comb as needed
+        std::uint32_t displace(table& t, std::vector<unsigned char> const& entries, size_t& lowest_free)
+        {
+            size_t base = lowest_free >= entries.front()? lowest_free - entries.front() : 0;
+            for (;; ++base)
+            {
+                if (t.owner.size() < base + t.nclasses)
+                {
+                    t.owner.resize(base + t.nclasses, table::unowned);
+                    t.target.resize(base + t.nclasses);
+                }
+                bool fits = true;
+                for (auto c : entries)
+                    if (t.owner[base + c] != table::unowned)
+                    {
+                        fits = false;
+                        break;
+                    }
+                if (fits)
+                    return base;
+            }
+        }
+    }
+
+    table pack(std::array<unsigned char, 256> const& classes, unsigned nclasses, std::vector<unsigned> const& next,
+               std::vector<unsigned> const& starts, options const& opts)
+    {
+        unsigned const n = next.size() / nclasses;
+        auto const row_of = [&](unsigned s) { return next.data() + size_t(s) * nclasses; };
+
+        table t;
+        t.classes  = classes;
+        t.nclasses = nclasses;
+        t.rows.resize(n);
+
+        // hottest first: by visit count if known, else breadth-first
+        std::vector<unsigned> order;
+        std::vector<char> seen(n);
+        auto visit = [&](unsigned s) {
+            if (!seen[s])
+            {
+                seen[s] = true;
+                order.push_back(s);
+            }
+        };
+        for (auto s : starts)
+            visit(s);
+        for (size_t i = 0; i < order.size(); ++i)
+            for (unsigned c = 0; c < nclasses; ++c)
+                visit(row_of(order[i])[c]);
+        for (unsigned s = 0; s < n; ++s) // unreachable, if any
+            visit(s);
+
+        auto const visits = opts.visits && opts.visits->size() == n? opts.visits : nullptr;
+        unsigned long long total = 0;
+        if (visits)
+        {
+            std::stable_sort(order.begin(), order.end(), [&](unsigned x, unsigned y) { return (*visits)[x] > (*visits)[y]; });
+            for (auto v : *visits)
+                total += v;
+        }
+        auto const rare = [&](unsigned s) { return visits && (*visits)[s] * 16 * n < total; };
+
+        size_t const dense_row = size_t(nclasses) * sizeof(std::uint32_t);
+        std::vector<char> dense(n);
+        for (size_t i = 0; i < order.size() && (i + 1) * dense_row <= opts.dense_bytes; ++i)
+        {
+            unsigned const s = order[i];
+            if (visits && !(*visits)[s])
+                break;
+            dense[s] = true;
+            t.rows[s] = row { std::uint32_t(t.dense.size()), 0, 0, encoding::dense };
+            t.dense.insert(t.dense.end(), row_of(s), row_of(s) + nclasses);
+        }
+
+        std::vector<unsigned> combed;
+        for (auto s : order)
+        {
+            if (dense[s])
+                continue;
+            auto const common = most_common(row_of(s), nclasses);
+            t.rows[s].fallback = common.first;
+            if (common.second > opts.sparse_limit && !rare(s))
+            {
+                t.rows[s].kind  = encoding::comb;
+                t.rows[s].count = common.second;
+                combed.push_back(s);
+                continue;
+            }
+            t.rows[s].kind = encoding::sparse;
+            t.rows[s].base = t.exception_class.size();
+            for (unsigned c = 0; c < nclasses; ++c)
+                if (row_of(s)[c] != common.first)
+                {
+                    t.exception_class.push_back(c);
+                    t.exception_target.push_back(row_of(s)[c]);
+                }
+            t.rows[s].count = t.exception_class.size() - t.rows[s].base;
+        }
+
+        // the fullest rows first, while the comb still has long gaps
+        std::stable_sort(combed.begin(), combed.end(), [&](unsigned x, unsigned y) { return t.rows[x].count > t.rows[y].count; });
+        size_t lowest_free = 0;
+        std::vector<unsigned char> entries;
+        for (auto s : combed)
+        {
+            row& r = t.rows[s];
+            entries.clear();
+            for (unsigned c = 0; c < nclasses; ++c)
+                if (row_of(s)[c] != r.fallback)
+                    entries.push_back(c);
+
+            r.base  = displace(t, entries, lowest_free);
+            r.count = 0;
+            for (auto c : entries)
+            {
+                t.owner[r.base + c]  = s;
+                t.target[r.base + c] = row_of(s)[c];
+            }
+            while (lowest_free < t.owner.size() && t.owner[lowest_free] != table::unowned)
+                ++lowest_free;
+        }
+        return t;
+    }
+
+    table pack(dfa::automaton const& a, options const& opts)
+    {
+        return pack(a.classes, a.nclasses, a.next, { a.start[0], a.start[1] }, opts);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef __PACKED__
+#define __PACKED__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace dfa { struct automaton; }
+
+// Transition storage for automata too large for a full [state][class]
+// table. Each state gets the cheapest row encoding that its density and
+// its heat allow; state ids are unchanged, so `step` replaces a lookup
+// in the full table.
+namespace packed
+{
+    enum class encoding : std::uint8_t
+    {
+        dense,  // all classes, in a block of `dense`
+        comb,   // the exceptions to `fallback`, displaced into the comb
+        sparse, // the exceptions to `fallback`, listed by class
+    };
+
+    struct row
+    {
+        std::uint32_t base;     // dense, comb: slot of class 0; sparse: first entry
+        std::uint32_t fallback; // comb, sparse: where a class without an entry goes
+        std::uint16_t count;    // sparse: entries
+        encoding      kind;
+    };
+
+    // Dense rows are stored hottest first, so the hot part of the table
+    // is one block. Comb rows share slots as in flex: a row's entry for
+    // class c sits at slot base + c, and `owner` tells whose it is. Every
+    // base leaves room for all classes, so a comb lookup needs no bounds
+    // check.
+    struct table
+    {
+        std::array<unsigned char, 256> classes;
+        unsigned                       nclasses;
+        std::vector<row>               rows;   // [state]
+        std::vector<std::uint32_t>     dense;  // [slot]
+        std::vector<std::uint32_t>     target; // [slot]
+        std::vector<std::uint32_t>     owner;  // [slot]: the state, or `unowned`
+        std::vector<unsigned char>     exception_class;  // [entry], ascending per row
+        std::vector<std::uint32_t>     exception_target; // [entry]
+
+        static std::uint32_t const unowned = ~std::uint32_t(0);
+
+        unsigned size() const { return rows.size(); }
+        unsigned count(encoding kind) const {
+            return std::count_if(rows.begin(), rows.end(), [=](row const& r) { return r.kind == kind; });
+        }
+        size_t bytes() const {
+            return rows.size() * sizeof(row) + (dense.size() + target.size() + owner.size() + exception_target.size()) * 4
+                 + exception_class.size() + sizeof(classes);
+        }
+
+        std::uint32_t lookup(std::uint32_t state, unsigned char cls) const {
+            row const& r = rows[state];
+            switch (r.kind)
+            {
+                case encoding::dense:
+                    return dense[r.base + cls];
+                case encoding::comb:
+                    return owner[r.base + cls] == state? target[r.base + cls] : r.fallback;
+                default:
+                {
+                    unsigned char const* first = exception_class.data() + r.base;
+                    unsigned char const* found = std::lower_bound(first, first + r.count, cls);
+                    return found != first + r.count && *found == cls? exception_target[found - exception_class.data()] : r.fallback;
+                }
+            }
+        }
+        std::uint32_t step(std::uint32_t state, unsigned char byte) const {
+            return lookup(state, classes[byte]);
+        }
+    };
+
+    struct options
+    {
+        // Dense rows are given to the hottest states (by `visits`, else
+        // breadth-first from `starts`) while they take at most this much.
+        size_t dense_bytes = 16 * 1024;
+        // rows with at most this many exceptions are listed, not combed
+        unsigned sparse_limit = 4;
+        // per state, e.g. profile::counts::visits; states visited less than
+        // a sixteenth of the average are listed whatever their density
+        std::vector<unsigned long long> const* visits = nullptr;
+    };
+
+    // `next` is a full table, [state * nclasses + class]; `starts` are the
+    // states scans begin in
+    table pack(std::array<unsigned char, 256> const& classes, unsigned nclasses, std::vector<unsigned> const& next,
+               std::vector<unsigned> const& starts, options const& opts = options());
+
+    table pack(dfa::automaton const& a, options const& opts = options());
+}
+
+#endif // __PACKED__
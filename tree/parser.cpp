@@ -77,7 +77,7 @@ template <typename It>
 
         group       = '(' >> alternative >> ')';
 
-        literal     = unescape | ~char_("\\+*?.^$|{()") ;
+        literal     = unescape | ~char_("\\+*?.^$|{()[") ;
 
         unescape    = ('\\' > char_);
 
@@ -0,0 +1,245 @@
+#include "planner.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace planner
+{
+    using glushkov::symbol_kind;
+
+    char const* name(engine e)
+    {
+        switch (e)
+        {
+            case engine::aho_corasick: return "aho-corasick";
+            case engine::dfa:          return "dfa";
+            case engine::nfa:          return "nfa";
+            case engine::tdfa:         return "tdfa";
+        }
+        return "?";
+    }
+
+    namespace
+    {
+        bool anchored_begin(glushkov::automaton const& fa)
+        {
+            return !fa.first.empty() && std::all_of(fa.first.begin(), fa.first.end(),
+                    [&](unsigned p) { return fa.positions[p].kind == symbol_kind::begin_assert; });
+        }
+
+        // '#' is only ever reached through '$'
+        bool anchored_end(glushkov::automaton const& fa)
+        {
+            unsigned const accept = fa.accept();
+            if (std::find(fa.first.begin(), fa.first.end(), accept) != fa.first.end())
+                return false;
+            for (unsigned p = 0; p < fa.positions.size(); ++p)
+            {
+                auto const& follow = fa.follow[p];
+                if (fa.positions[p].kind != symbol_kind::end_assert
+                        && std::find(follow.begin(), follow.end(), accept) != follow.end())
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    plan analyze(ast::regex const& tree, options const& opts)
+    {
+        plan out;
+        traits& t = out.pattern;
+        auto because = [&](std::string why) { out.reasons.push_back(std::move(why)); };
+
+        // counted first: cheap however large the repeats are, and enough
+        // for everything but the DFA probe
+        glushkov::options counting;
+        counting.icase       = opts.icase;
+        counting.count_above = opts.count_above;
+        auto const fa = glushkov::build(tree, counting);
+
+        t.positions      = fa.positions.size();
+        t.groups         = glushkov::count_groups(tree) - 1;
+        t.anchored_begin = anchored_begin(fa);
+        t.anchored_end   = anchored_end(fa);
+        for (auto& pos : fa.positions)
+            if (pos.counted())
+            {
+                t.largest_repeat = std::max(t.largest_repeat, pos.max_count);
+                t.positions     += pos.max_count - 1; // as unrolled
+            }
+
+        auto const keywords = aho_corasick::literals(tree);
+        if (keywords)
+        {
+            t.keywords = keywords->size();
+            t.literal  = keywords->size() == 1;
+        }
+
+        if (opts.wanted == goal::captures)
+        {
+            out.chosen = engine::tdfa;
+            because("groups wanted: only the tagged DFA reports them (" + std::to_string(t.groups) + " besides the match)");
+            return out;
+        }
+
+        if (keywords && !opts.icase)
+        {
+            out.chosen = engine::aho_corasick;
+            if (t.literal)
+                because("a single literal: keyword search, skipping to its first byte");
+            else
+                because("an alternation of " + std::to_string(t.keywords) + " literals: keyword automaton, no positions");
+            return out;
+        }
+        if (keywords)
+            because("literals, but case-insensitive: the keyword automaton doesn't fold case");
+
+        if (t.anchored_begin)
+            because("anchored at the start: a scan ends at the first byte no match can take");
+        if (t.anchored_end)
+            because("anchored at the end: every match reaches the end of the text");
+
+        if (t.largest_repeat && opts.wanted == goal::search)
+        {
+            out.chosen = engine::nfa;
+            because("a bounded repeat up to " + std::to_string(t.largest_repeat) + ": one counter instead of as many positions");
+            return out;
+        }
+        if (t.largest_repeat)
+            because("a bounded repeat up to " + std::to_string(t.largest_repeat) + " is unrolled, only the NFA counts and it has no spans");
+
+        // The probe runs on the unrolled automaton, which is `fa` unless a
+        // repeat was counted. The DFA is built again by dfa::matcher; the
+        // probe only pays twice for patterns that stay under the budget, and
+        // stops there however many states the unrolled repeat would need.
+        glushkov::automaton unrolled;
+        if (t.largest_repeat)
+        {
+            glushkov::options plain;
+            plain.icase = opts.icase;
+            unrolled = glushkov::build(tree, plain);
+        }
+        auto const probe = dfa::determinize(t.largest_repeat? unrolled : fa, dfa::match_kind::leftmost_first, true, opts.max_states);
+        if (probe)
+        {
+            t.dfa_states = probe->size();
+            out.chosen = engine::dfa;
+            because("forward DFA: " + std::to_string(t.dfa_states) + " states from " + std::to_string(t.positions) + " positions");
+            return out;
+        }
+
+        t.explodes = true;
+        if (opts.wanted == goal::search)
+        {
+            out.chosen = engine::nfa;
+            because("forward DFA over " + std::to_string(opts.max_states) + " states: simulating " + std::to_string(t.positions) + " positions instead");
+        } else
+        {
+            out.chosen = engine::dfa;
+            because("forward DFA over " + std::to_string(opts.max_states) + " states, but only the DFA engines report spans");
+        }
+        return out;
+    }
+
+    std::ostream& write_json(std::ostream& os, traits const& v)
+    {
+        return os << "{"
+            << "\"positions\":"      << v.positions << ","
+            << "\"groups\":"         << v.groups << ","
+            << "\"keywords\":"       << v.keywords << ","
+            << "\"literal\":"        << std::boolalpha << v.literal << ","
+            << "\"anchored_begin\":" << v.anchored_begin << ","
+            << "\"anchored_end\":"   << v.anchored_end << ","
+            << "\"largest_repeat\":" << v.largest_repeat << ","
+            << "\"dfa_states\":"     << v.dfa_states << ","
+            << "\"explodes\":"       << v.explodes << std::noboolalpha
+            << "}";
+    }
+
+    std::ostream& write_json(std::ostream& os, plan const& v)
+    {
+        os << "{\"engine\":\"" << name(v.chosen) << "\",\"pattern\":";
+        write_json(os, v.pattern);
+        os << ",\"reasons\":[";
+        for (size_t i = 0; i < v.reasons.size(); ++i)
+            os << (i? "," : "") << "\"" << v.reasons[i] << "\"";
+        return os << "]}";
+    }
+
+    namespace
+    {
+        matcher::backend compile(ast::regex const& tree, plan const& p, options const& opts)
+        {
+            switch (p.chosen)
+            {
+                case engine::aho_corasick: return aho_corasick::matcher(*aho_corasick::literals(tree));
+                case engine::nfa:          return nfa::matcher(tree, opts.count_above, opts.icase);
+                case engine::tdfa:         return tdfa::matcher(tree, opts.icase);
+                case engine::dfa:          break;
+            }
+            return dfa::matcher(tree, dfa::match_kind::leftmost_first, opts.icase);
+        }
+
+        struct compiled_stats : boost::static_visitor<stats::compile const&>
+        {
+            template <typename M> stats::compile const& operator()(M const& m) const { return m.compiled; }
+        };
+
+        struct searcher : boost::static_visitor<bool>
+        {
+            char const *begin, *end;
+            stats::scan* counters;
+
+            searcher(char const* begin, char const* end, stats::scan* counters)
+                : begin(begin), end(end), counters(counters) {}
+
+            template <typename M> bool operator()(M const& m) const { return m.search(begin, end, counters); }
+            bool operator()(tdfa::matcher const& m) const { return m.locate.search(begin, end, counters); }
+        };
+
+        struct finder : boost::static_visitor<boost::optional<dfa::span>>
+        {
+            char const *begin, *end, *from;
+            stats::scan* counters;
+
+            finder(char const* begin, char const* end, char const* from, stats::scan* counters)
+                : begin(begin), end(end), from(from), counters(counters) {}
+
+            template <typename M> boost::optional<dfa::span> operator()(M const& m) const { return m.find(begin, end, from, counters); }
+            boost::optional<dfa::span> operator()(tdfa::matcher const& m) const { return m.locate.find(begin, end, from, counters); }
+            boost::optional<dfa::span> operator()(nfa::matcher const&) const {
+                throw std::logic_error("planner::matcher::find: the NFA reports no spans; plan for goal::spans");
+            }
+        };
+    }
+
+    matcher::matcher(ast::regex const& tree, options const& opts)
+        : chosen(analyze(tree, opts)), compiled_(compile(tree, chosen, opts))
+    { }
+
+    stats::compile const& matcher::compiled() const
+    {
+        return boost::apply_visitor(compiled_stats(), compiled_);
+    }
+
+    bool matcher::search(char const* begin, char const* end, stats::scan* counters) const
+    {
+        return boost::apply_visitor(searcher(begin, end, counters), compiled_);
+    }
+
+    boost::optional<dfa::span> matcher::find(char const* begin, char const* end, char const* from, stats::scan* counters) const
+    {
+        return boost::apply_visitor(finder(begin, end, from, counters), compiled_);
+    }
+
+    bool matcher::find(char const* begin, char const* end, char const* from, tdfa::captures& out, stats::scan* counters) const
+    {
+        if (auto m = boost::get<tdfa::matcher>(&compiled_))
+            return m->find(begin, end, from, out, counters);
+
+        auto const found = find(begin, end, from, counters);
+        if (!found)
+            return false;
+        out.assign(1, *found);
+        return true;
+    }
+}
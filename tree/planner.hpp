@@ -0,0 +1,107 @@
+#ifndef __PLANNER__
+#define __PLANNER__
+
+#include "ast.hpp"
+#include "aho_corasick.hpp"
+#include "dfa.hpp"
+#include "nfa.hpp"
+#include "stats.hpp"
+#include "tdfa.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/variant.hpp>
+
+namespace planner
+{
+    // what the caller needs from a match
+    enum class goal
+    {
+        search,   // only whether there is one (lines, filters)
+        spans,    // where it is
+        captures, // where it and its groups are
+    };
+
+    enum class engine { aho_corasick, dfa, nfa, tdfa };
+
+    char const* name(engine e);
+
+    // what the analysis found out about a pattern
+    struct traits
+    {
+        unsigned positions      = 0;     // glushkov positions, repeats unrolled
+        unsigned groups         = 0;     // capture groups, not counting group 0
+        unsigned keywords       = 0;     // strings of a literal set, else 0
+        bool     literal        = false; // a single literal string
+        bool     anchored_begin = false; // every match starts at the text start
+        bool     anchored_end   = false; // every match ends at the text end
+        unsigned largest_repeat = 0;     // bound of the largest countable repeat, or 0
+        unsigned dfa_states     = 0;     // of the forward DFA, 0 if over budget or not probed
+        bool     explodes       = false; // the forward DFA is over budget
+    };
+
+    struct plan
+    {
+        engine                   chosen;
+        traits                   pattern;
+        std::vector<std::string> reasons; // why, in the order they were decided
+    };
+
+    struct options
+    {
+        goal     wanted      = goal::spans;
+        bool     icase       = false;
+
+        // a bounded repeat of one position above this is left counted
+        // (nfa::matcher) rather than unrolled into the DFA
+        unsigned count_above = 16;
+
+        // the forward DFA may have this many states before the pattern
+        // counts as exploding
+        unsigned max_states  = 4096;
+    };
+
+    // Classifies a pattern and picks the engine for it:
+    //  - captures wanted: the tagged DFA, the only engine that reports groups
+    //  - a literal or literal set: Aho-Corasick, with no position automaton
+    //  - a large bounded repeat or a state explosion: the counting NFA, when
+    //    only a yes/no is needed; the DFA otherwise, as the NFA has no spans
+    //  - anything else: the DFA
+    // The positions are built with repeats counted. A pattern that gets as
+    // far as the DFA is unrolled and its forward DFA probed under
+    // `max_states`, so `explodes` holds for large repeats too; the probe
+    // stops at the budget.
+    plan analyze(ast::regex const& tree, options const& opts = options());
+
+    std::ostream& write_json(std::ostream& os, traits const& v);
+    std::ostream& write_json(std::ostream& os, plan const& v);
+
+    // Runs a pattern on the engine its plan chose.
+    class matcher
+    {
+      public:
+        using backend = boost::variant<aho_corasick::matcher, dfa::matcher, nfa::matcher, tdfa::matcher>;
+
+      private:
+        plan    chosen;
+        backend compiled_;
+
+      public:
+        explicit matcher(ast::regex const& tree, options const& opts = options());
+
+        plan const&           planned()  const { return chosen; }
+        stats::compile const& compiled() const;
+
+        bool search(char const* begin, char const* end, stats::scan* counters = nullptr) const;
+
+        // not for a goal::search plan, which may run the NFA: with the NFA
+        // chosen it throws std::logic_error
+        boost::optional<dfa::span> find(char const* begin, char const* end, char const* from, stats::scan* counters = nullptr) const;
+
+        // only group 0 is set unless the plan was made for goal::captures
+        bool find(char const* begin, char const* end, char const* from, tdfa::captures& out, stats::scan* counters = nullptr) const;
+    };
+}
+
+#endif // __PLANNER__
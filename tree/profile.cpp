@@ -0,0 +1,61 @@
+#include "profile.hpp"
+
+namespace profile
+{
+    counts::counts(unsigned states, unsigned nclasses)
+        : nclasses(nclasses), visits(states), steps(size_t(states) * nclasses)
+    { }
+
+    counts& counts::operator+=(counts const& other)
+    {
+        if (visits.size() < other.visits.size())
+            visits.resize(other.visits.size());
+        if (steps.size() < other.steps.size())
+            steps.resize(other.steps.size());
+        nclasses = other.nclasses;
+
+        for (size_t s = 0; s < other.visits.size(); ++s)
+            visits[s] += other.visits[s];
+        for (size_t i = 0; i < other.steps.size(); ++i)
+            steps[i] += other.steps[i];
+        dead_exits       += other.dead_exits;
+        prefilter_hits   += other.prefilter_hits;
+        prefilter_misses += other.prefilter_misses;
+        return *this;
+    }
+
+    recorder::recorder(unsigned states, unsigned nclasses)
+        : shared(std::make_shared<blocks>())
+    {
+        shared->states   = states;
+        shared->nclasses = nclasses;
+    }
+
+    counts& recorder::local() const
+    {
+        auto const self = std::this_thread::get_id();
+        std::lock_guard<std::mutex> hold(shared->lock);
+        for (auto& t : shared->threads)
+            if (t.first == self)
+                return *t.second;
+        shared->threads.emplace_back(self, std::unique_ptr<counts>(new counts(shared->states, shared->nclasses)));
+        return *shared->threads.back().second;
+    }
+
+    counts recorder::merged() const
+    {
+        counts sum(shared->states, shared->nclasses);
+        std::lock_guard<std::mutex> hold(shared->lock);
+        for (auto& t : shared->threads)
+            sum += *t.second;
+        return sum;
+    }
+
+    void recorder::clear()
+    {
+        // zeroed in place: a scan running now may hold on to its block
+        std::lock_guard<std::mutex> hold(shared->lock);
+        for (auto& t : shared->threads)
+            *t.second = counts(shared->states, shared->nclasses);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef __PROFILE__
+#define __PROFILE__
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Hit counters for the scan loops of the automaton engines. They only
+// count in a build with -DDFA_PROFILE; otherwise the loops get
+// `null_probe`, whose calls are empty and compile away, and the counts
+// stay zero.
+namespace profile
+{
+    struct counts
+    {
+        unsigned nclasses = 0;
+        std::vector<unsigned long long> visits; // [state]: bytes read in it
+        std::vector<unsigned long long> steps;  // [state * nclasses + class]
+
+        unsigned long long dead_exits       = 0; // scans ended by the dead state
+        unsigned long long prefilter_hits   = 0; // positions a prefilter skipped to
+        unsigned long long prefilter_misses = 0; // of those, left again without a match
+
+        counts() = default;
+        counts(unsigned states, unsigned nclasses);
+
+        counts& operator+=(counts const& other);
+    };
+
+    // The counts of one automaton, a block per thread that scanned it so
+    // the scans don't share cache lines; merged on demand. Copies share
+    // the blocks.
+    class recorder
+    {
+        struct blocks
+        {
+            unsigned   states, nclasses;
+            std::mutex lock;
+            std::vector<std::pair<std::thread::id, std::unique_ptr<counts>>> threads;
+        };
+        std::shared_ptr<blocks> shared;
+
+      public:
+        recorder(unsigned states = 0, unsigned nclasses = 0);
+
+        counts& local() const; // the calling thread's block
+
+        // the sum over all threads; exact once no scan is running
+        counts merged() const;
+        void   clear();
+    };
+
+    // What a scan loop reports to, once per scan: the state of every byte
+    // read, and how the scan ended.
+    class counting_probe
+    {
+        counts& hits;
+        bool    pending = false; // since the last prefilter hit, no match yet
+
+      public:
+        explicit counting_probe(recorder const& r) : hits(r.local()) {}
+
+        void step(unsigned state, unsigned char cls) {
+            ++hits.visits[state];
+            ++hits.steps[state * hits.nclasses + cls];
+        }
+        void dead() { ++hits.dead_exits; }
+
+        // the prefilter stopped at a candidate / the scan is back where
+        // the prefilter takes over / the scan matched
+        void candidate() { ++hits.prefilter_hits; pending = true; }
+        void restart()   { hits.prefilter_misses += pending; pending = false; }
+        void matched()   { pending = false; }
+    };
+
+    struct null_probe
+    {
+        explicit null_probe(recorder const&) {}
+
+        void step(unsigned, unsigned char) {}
+        void dead() {}
+        void candidate() {}
+        void restart() {}
+        void matched() {}
+    };
+
+#ifdef DFA_PROFILE
+    using probe = counting_probe;
+#else
+    using probe = null_probe;
+#endif
+}
+
+#endif // __PROFILE__
@@ -0,0 +1,154 @@
+#include "relation.hpp"
+#include "glushkov.hpp"
+#include <algorithm>
+#include <map>
+
+namespace relation
+{
+    namespace
+    {
+        // a side's state once the search has seen a match: it stays matched
+        // whatever follows
+        unsigned const matched = ~0u;
+
+        struct side
+        {
+            dfa::automaton const& a;
+            scope                 where;
+
+            unsigned start() const { return settle(a.start[0]); }
+
+            unsigned step(unsigned s, unsigned char byte) const {
+                return s == matched? matched : settle(a.step(s, byte));
+            }
+
+            unsigned settle(unsigned s) const {
+                return where == scope::anywhere && a.accepting[s]? matched : s;
+            }
+
+            // whether the text matches if it ends in `s`
+            bool accepts(unsigned s) const {
+                return s == matched || a.eot_accepting[s];
+            }
+
+            // nothing that follows can change whether the text matches
+            bool settled(unsigned s) const {
+                return s == matched || s == dfa::automaton::dead;
+            }
+        };
+
+        // one byte per pair of classes the two automata put it in,
+        // printable ones preferred
+        std::vector<unsigned char> joint_bytes(dfa::automaton const& first, dfa::automaton const& second)
+        {
+            std::vector<unsigned> order;
+            for (unsigned b = 0x21; b < 0x7f; ++b)
+                order.push_back(b);
+            order.push_back(' ');
+            for (unsigned b = 0; b < 256; ++b)
+                if (b < 0x20 || b >= 0x7f)
+                    order.push_back(b);
+
+            std::vector<char> seen(first.nclasses * second.nclasses);
+            std::vector<unsigned char> bytes;
+            for (auto b : order)
+            {
+                unsigned const pair = first.classes[b] * second.nclasses + second.classes[b];
+                if (!seen[pair])
+                {
+                    seen[pair] = 1;
+                    bytes.push_back(b);
+                }
+            }
+            return bytes;
+        }
+    }
+
+    dfa::automaton language(ast::regex const& tree, scope where, bool icase)
+    {
+        glushkov::options opts;
+        opts.icase = icase;
+        return dfa::determinize(glushkov::build(tree, opts), dfa::match_kind::leftmost_longest, where == scope::anywhere);
+    }
+
+    comparison compare(dfa::automaton const& first, dfa::automaton const& second, scope where)
+    {
+        side const a { first, where }, b { second, where };
+        auto const bytes = joint_bytes(first, second);
+
+        // breadth first, so the first text found of each kind is a
+        // shortest one; a pair is reached by `from` and `byte`
+        struct pair
+        {
+            unsigned      s, t;
+            unsigned      from;
+            unsigned char byte;
+        };
+        std::vector<pair> reached { pair { a.start(), b.start(), 0, 0 } };
+        std::map<std::pair<unsigned, unsigned>, unsigned> ids { { { reached[0].s, reached[0].t }, 0 } };
+
+        auto text = [&](unsigned i) {
+            std::string out;
+            for (; i != 0; i = reached[i].from)
+                out += reached[i].byte;
+            std::reverse(out.begin(), out.end());
+            return out;
+        };
+
+        comparison out;
+        for (unsigned i = 0; i < reached.size() && !(out.only_first && out.only_second && out.both); ++i)
+        {
+            unsigned const s = reached[i].s, t = reached[i].t;
+            bool const in_first = a.accepts(s), in_second = b.accepts(t);
+            if (in_first && !in_second && !out.only_first)
+                out.only_first = text(i);
+            if (!in_first && in_second && !out.only_second)
+                out.only_second = text(i);
+            if (in_first && in_second && !out.both)
+                out.both = text(i);
+
+            if (a.settled(s) && b.settled(t))
+                continue;
+            for (auto byte : bytes)
+            {
+                unsigned const s2 = a.step(s, byte), t2 = b.step(t, byte);
+                if (ids.emplace(std::make_pair(s2, t2), reached.size()).second)
+                    reached.push_back(pair { s2, t2, i, byte });
+            }
+        }
+        return out;
+    }
+
+    std::vector<redundancy> redundant(std::vector<dfa::automaton> const& rules, scope where)
+    {
+        unsigned const n = rules.size();
+        std::vector<char> within(n * n); // [i * n + j]: i matches nothing j doesn't
+        for (unsigned i = 0; i < n; ++i)
+            for (unsigned j = i + 1; j < n; ++j)
+            {
+                auto const c = compare(rules[i], rules[j], where);
+                within[i * n + j] = c.first_in_second();
+                within[j * n + i] = c.second_in_first();
+            }
+
+        // a rule goes if another covers it that is strictly larger, or
+        // equivalent and earlier; following such covers ends at a kept
+        // rule, which covers it too
+        std::vector<char> goes(n);
+        for (unsigned i = 0; i < n; ++i)
+            for (unsigned j = 0; j < n && !goes[i]; ++j)
+                goes[i] = j != i && within[i * n + j] && (!within[j * n + i] || j < i);
+
+        std::vector<redundancy> out;
+        for (unsigned i = 0; i < n; ++i)
+        {
+            if (!goes[i])
+                continue;
+            unsigned j = 0;
+            while (goes[j] || !within[i * n + j])
+                ++j;
+            out.push_back(redundancy { i, j, bool(within[j * n + i]) });
+        }
+        return out;
+    }
+}
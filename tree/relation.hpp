@@ -0,0 +1,55 @@
+#ifndef __RELATION__
+#define __RELATION__
+
+#include "ast.hpp"
+#include "dfa.hpp"
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace relation
+{
+    // which texts count as matched by a pattern
+    enum class scope
+    {
+        whole_text, // the pattern matches all of it (validation)
+        anywhere,   // the pattern matches somewhere in it (search)
+    };
+
+    // the DFA `compare` expects for `where`: anchored for whole_text,
+    // unanchored for anywhere; leftmost_longest, which keeps every thread
+    // a longer match could continue
+    dfa::automaton language(ast::regex const& tree, scope where, bool icase = false);
+
+    // How the matched texts of two patterns relate, from a breadth-first
+    // walk of the product of their DFAs. Each field is a shortest text of
+    // its kind, none if there is no such text; printable bytes are tried
+    // first so the examples read well.
+    struct comparison
+    {
+        boost::optional<std::string> only_first, only_second, both;
+
+        bool first_in_second() const { return !only_first; }
+        bool second_in_first() const { return !only_second; }
+        bool equivalent()      const { return !only_first && !only_second; }
+        bool intersect()       const { return bool(both); }
+    };
+
+    // `first` and `second` from `language` with the same `where`
+    comparison compare(dfa::automaton const& first, dfa::automaton const& second, scope where);
+
+    struct redundancy
+    {
+        unsigned rule;       // index of the rule that can go
+        unsigned kept;       // index of a kept rule matching everything it does
+        bool     equivalent; // kept matches nothing more either
+    };
+
+    // The rules whose every match some other rule makes too, by index,
+    // each with a rule to keep that covers it; of equivalent rules the
+    // first is kept. Dropping them all leaves the matched texts of the set
+    // unchanged. Pairwise: n * (n - 1) / 2 product walks.
+    std::vector<redundancy> redundant(std::vector<dfa::automaton> const& rules, scope where);
+}
+
+#endif // __RELATION__
@@ -0,0 +1,150 @@
+#include "ruleset.hpp"
+#include "dfa.hpp"
+#include "subset.hpp"
+#include <algorithm>
+
+namespace ruleset
+{
+    namespace
+    {
+        // a state carries a bit for every rule whose '#' is live
+        struct any_rule
+        {
+            using value = std::uint64_t;
+
+            static value none() { return 0; }
+            static void  add(value& v, unsigned rule) { v |= value(1) << rule; }
+        };
+    }
+
+    shard compile(std::vector<std::uint32_t> const& ids, std::vector<glushkov::automaton const*> const& rules)
+    {
+        std::vector<int> rule_of;
+        auto const fa = glushkov::combine(rules, rule_of);
+
+        shard out;
+        out.ids = ids;
+        std::array<unsigned char, 256> classes;
+        unsigned const nclasses = dfa::byte_classes(fa, classes);
+
+        // with a fresh attempt of every rule at every byte, a state is the
+        // set of positions live in any of them
+        subset::set_builder<any_rule> builder(fa, rule_of, true);
+        out.start[0] = builder.initial(true);
+        out.start[1] = builder.initial(false);
+        std::vector<unsigned> next; // [state * nclasses + class]
+        subset::expand(builder, classes, nclasses, next);
+
+        out.next        = packed::pack(classes, nclasses, next, { out.start[0], out.start[1] });
+        out.accepts     = std::move(builder.accepts);
+        out.eot_accepts = std::move(builder.eot_accepts);
+        return out;
+    }
+
+    std::vector<std::uint32_t> version::matching(char const* begin, char const* end) const
+    {
+        std::vector<std::uint32_t> found;
+        for (auto& part : shards)
+        {
+            shard const& a = *part;
+            std::uint64_t const* accepts = a.accepts.data();
+            std::uint64_t const all = a.ids.size() == 64? ~std::uint64_t(0) : (std::uint64_t(1) << a.ids.size()) - 1;
+
+            // once every rule of the shard has matched the rest can't add any
+            unsigned s = a.start[0];
+            std::uint64_t seen = accepts[s];
+            for (char const* p = begin; p != end && seen != all; ++p)
+            {
+                s = a.next.step(s, *p);
+                seen |= accepts[s];
+            }
+            seen |= a.eot_accepts[s];
+
+            for (unsigned i = 0; i < a.ids.size(); ++i)
+                if (seen >> i & 1)
+                    found.push_back(a.ids[i]);
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+    set::set(unsigned rules_per_shard)
+        : per_shard(std::min(std::max(rules_per_shard, 1u), 64u)), published(std::make_shared<version const>())
+    { }
+
+    bool set::add(std::uint32_t id, std::string const& pattern)
+    {
+        auto positions = glushkov::compile(pattern);
+        if (!positions)
+            return false;
+        auto shared = std::make_shared<glushkov::automaton const>(std::move(*positions));
+
+        std::lock_guard<std::mutex> hold(writing);
+        auto found = rules.find(id);
+        if (found != rules.end())
+        {
+            found->second.positions = shared;
+            dirty[found->second.shard] = true;
+            return true;
+        }
+
+        unsigned target = 0;
+        while (target < members.size() && members[target].size() >= per_shard)
+            ++target;
+        if (target == members.size())
+        {
+            members.emplace_back();
+            dirty.push_back(false);
+            built.emplace_back();
+        }
+        members[target].push_back(id);
+        dirty[target] = true;
+        rules[id] = rule { shared, target };
+        return true;
+    }
+
+    bool set::remove(std::uint32_t id)
+    {
+        std::lock_guard<std::mutex> hold(writing);
+        auto found = rules.find(id);
+        if (found == rules.end())
+            return false;
+
+        auto& ids = members[found->second.shard];
+        ids.erase(std::find(ids.begin(), ids.end(), id));
+        dirty[found->second.shard] = true;
+        rules.erase(found);
+        return true;
+    }
+
+    void set::commit()
+    {
+        std::lock_guard<std::mutex> hold(writing);
+        for (unsigned i = 0; i < members.size(); ++i)
+        {
+            if (!dirty[i])
+                continue;
+            dirty[i] = false;
+            if (members[i].empty())
+            {
+                built[i].reset();
+                continue;
+            }
+            std::vector<glushkov::automaton const*> parts;
+            for (auto id : members[i])
+                parts.push_back(rules.at(id).positions.get());
+            built[i] = std::make_shared<shard const>(compile(members[i], parts));
+        }
+
+        auto next = std::make_shared<version>();
+        for (auto& part : built)
+            if (part)
+                next->shards.push_back(part);
+        std::atomic_store(&published, std::shared_ptr<version const>(std::move(next)));
+    }
+
+    std::shared_ptr<version const> set::current() const
+    {
+        return std::atomic_load(&published);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef __RULESET__
+#define __RULESET__
+
+#include "glushkov.hpp"
+#include "packed.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ruleset
+{
+    // Up to 64 rules compiled together: one unanchored DFA whose states
+    // carry a bit per rule with a match ending there. Its transitions are
+    // packed, so a shard with many states keeps dense rows only for those
+    // near the start.
+    struct shard
+    {
+        std::vector<std::uint32_t> ids; // by bit
+        packed::table              next;
+        std::vector<std::uint64_t> accepts;     // rules with a match ending before the next byte
+        std::vector<std::uint64_t> eot_accepts; // the same if the text ends here
+        unsigned                   start[2];    // as dfa::automaton::start
+
+        unsigned size() const { return accepts.size(); }
+    };
+
+    // the rules' positions, `rules[i]` getting bit i
+    shard compile(std::vector<std::uint32_t> const& ids, std::vector<glushkov::automaton const*> const& rules);
+
+    // One published state of a set: readers hold on to it for as long as
+    // they scan, so a later commit never changes it under them.
+    struct version
+    {
+        std::vector<std::shared_ptr<shard const>> shards;
+
+        // ids of the rules with a match in [begin, end), ascending
+        std::vector<std::uint32_t> matching(char const* begin, char const* end) const;
+    };
+
+    // A set of patterns that changes a few at a time. Each rule keeps its
+    // positions and its shard; `commit` recompiles only the shards that
+    // gained or lost a rule and publishes a new version that shares the
+    // others with the old one. Readers take `current()` without locking
+    // and keep matching against it while a commit builds the next.
+    class set
+    {
+      public:
+        // fewer rules per shard make a shard cheaper to rebuild and less
+        // likely to blow up, more make a scan take fewer passes; at most 64
+        explicit set(unsigned rules_per_shard = 16);
+
+        // staged until the next commit; false if the pattern doesn't parse
+        // (or, for remove, there's no such rule). Adding an existing id
+        // replaces its pattern.
+        bool add(std::uint32_t id, std::string const& pattern);
+        bool remove(std::uint32_t id);
+
+        // rebuilds what add/remove touched and publishes it
+        void commit();
+
+        std::shared_ptr<version const> current() const;
+
+      private:
+        struct rule
+        {
+            std::shared_ptr<glushkov::automaton const> positions;
+            unsigned                                   shard;
+        };
+
+        unsigned const                            per_shard;
+        std::mutex                                writing; // add, remove, commit
+        std::map<std::uint32_t, rule>             rules;
+        std::vector<std::vector<std::uint32_t>>   members; // rule ids by shard
+        std::vector<char>                         dirty;   // by shard
+        std::vector<std::shared_ptr<shard const>> built;   // by shard, as last committed
+        std::shared_ptr<version const>            published;
+    };
+}
+
+#endif // __RULESET__
@@ -0,0 +1,53 @@
+#ifndef __SIMD__
+#define __SIMD__
+
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace util
+{
+    // the first `byte` in [p, end), or end; compares 16 bytes at a time
+    // where SSE2 is available
+    inline char const* find_byte(char const* p, char const* end, char byte)
+    {
+#ifdef __SSE2__
+        __m128i const needle = _mm_set1_epi8(byte);
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+            int const hits = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+            if (hits)
+                return p + __builtin_ctz(hits);
+        }
+#endif
+        auto found = static_cast<char const*>(std::memchr(p, byte, end - p));
+        return found? found : end;
+    }
+
+    // the first byte in [p, end) that is one of set[0, n), or end; n <= 16
+    inline char const* find_any(char const* p, char const* end, char const* set, unsigned n)
+    {
+#ifdef __SSE2__
+        __m128i needles[16];
+        for (unsigned i = 0; i < n; ++i)
+            needles[i] = _mm_set1_epi8(set[i]);
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+            __m128i hits = _mm_setzero_si128();
+            for (unsigned i = 0; i < n; ++i)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[i]));
+            if (int const mask = _mm_movemask_epi8(hits))
+                return p + __builtin_ctz(mask);
+        }
+#endif
+        for (; p != end; ++p)
+            if (std::memchr(set, *p, n))
+                return p;
+        return end;
+    }
+}
+
+#endif // __SIMD__
@@ -0,0 +1,18 @@
+#ifndef __SLICE__
+#define __SLICE__
+
+#include <cstddef>
+
+namespace util
+{
+    // a piece of text that is searched on its own, e.g. a line or a record
+    struct slice
+    {
+        char const* begin;
+        char const* end;
+
+        size_t size() const { return end - begin; }
+    };
+}
+
+#endif // __SLICE__
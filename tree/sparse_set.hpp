@@ -0,0 +1,52 @@
+#ifndef __SPARSE_SET__
+#define __SPARSE_SET__
+
+#include <vector>
+
+namespace util
+{
+    // Set of integers below a fixed capacity with O(1) insert, lookup and
+    // clear (Briggs & Torczon): `dense` lists the members in insertion
+    // order, `sparse` maps a value to its slot in `dense`. A stale `sparse`
+    // entry is harmless because it has to point back at its value, so
+    // clearing only resets the count and the cost of a simulation step
+    // follows the live members, not the capacity.
+    class sparse_set
+    {
+        std::vector<unsigned> dense, sparse;
+        unsigned              count = 0;
+
+      public:
+        explicit sparse_set(unsigned capacity = 0) : dense(capacity), sparse(capacity) {}
+
+        bool contains(unsigned v) const {
+            unsigned const slot = sparse[v];
+            return slot < count && dense[slot] == v;
+        }
+
+        // false if `v` was already a member
+        bool insert(unsigned v) {
+            if (contains(v))
+                return false;
+            sparse[v]      = count;
+            dense[count++] = v;
+            return true;
+        }
+
+        void clear()             { count = 0; }
+        bool empty()       const { return count == 0; }
+        unsigned size()    const { return count; }
+        unsigned capacity() const { return dense.size(); }
+
+        unsigned const* begin() const { return dense.data(); }
+        unsigned const* end()   const { return dense.data() + count; }
+
+        void swap(sparse_set& other) {
+            dense.swap(other.dense);
+            sparse.swap(other.sparse);
+            std::swap(count, other.count);
+        }
+    };
+}
+
+#endif // __SPARSE_SET__
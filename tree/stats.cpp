@@ -0,0 +1,36 @@
+#include "stats.hpp"
+
+namespace stats
+{
+    std::ostream& write_json(std::ostream& os, compile const& v)
+    {
+        return os << "{"
+            << "\"positions\":"   << v.positions   << ","
+            << "\"states\":"      << v.states      << ","
+            << "\"classes\":"     << v.classes     << ","
+            << "\"transitions\":" << v.transitions << ","
+            << "\"table_bytes\":" << v.table_bytes << ","
+            << "\"seconds\":{"
+                << "\"parse\":"       << v.time.parse     << ","
+                << "\"positions\":"   << v.time.positions << ","
+                << "\"determinize\":" << v.time.determinize
+            << "}}";
+    }
+
+    std::ostream& write_json(std::ostream& os, scan const& v)
+    {
+        return os << "{"
+            << "\"bytes\":"   << v.bytes << ","
+            << "\"matches\":" << v.matches
+            << "}";
+    }
+
+    std::ostream& write_json(std::ostream& os, report const& v)
+    {
+        os << "{\"compile\":";
+        write_json(os, v.compiled);
+        os << ",\"scan\":";
+        write_json(os, v.scanned);
+        return os << "}";
+    }
+}
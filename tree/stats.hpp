@@ -0,0 +1,65 @@
+#ifndef __STATS__
+#define __STATS__
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+
+namespace stats
+{
+    struct timings // seconds per compile stage
+    {
+        double parse       = 0;
+        double positions   = 0; // nullable/firstpos/followpos
+        double determinize = 0;
+    };
+
+    struct compile
+    {
+        unsigned positions   = 0;
+        unsigned states      = 0;
+        unsigned classes     = 0;
+        size_t   transitions = 0;
+        size_t   table_bytes = 0;
+        timings  time;
+    };
+
+    struct scan
+    {
+        unsigned long long bytes   = 0;
+        unsigned long long matches = 0;
+
+        scan& operator+=(scan const& other) {
+            bytes   += other.bytes;
+            matches += other.matches;
+            return *this;
+        }
+    };
+
+    struct report
+    {
+        compile compiled;
+        scan    scanned;
+    };
+
+    std::ostream& write_json(std::ostream& os, compile const& v);
+    std::ostream& write_json(std::ostream& os, scan const& v);
+    std::ostream& write_json(std::ostream& os, report const& v);
+
+    class stopwatch
+    {
+        using clock = std::chrono::steady_clock;
+        clock::time_point start = clock::now();
+
+      public:
+        // seconds since construction or the previous lap
+        double lap() {
+            auto const now = clock::now();
+            double const elapsed = std::chrono::duration<double>(now - start).count();
+            start = now;
+            return elapsed;
+        }
+    };
+}
+
+#endif // __STATS__
@@ -0,0 +1,225 @@
+#ifndef __SUBSET__
+#define __SUBSET__
+
+#include "glushkov.hpp"
+#include "sparse_set.hpp"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Subset construction over a glushkov automaton, as the DFA engines
+// (dfa, lexer, ruleset) share it: how a position is entered, which
+// accepts wait for the end of the text, how states are numbered and
+// expanded. Assertions are handled here and nowhere else.
+namespace subset
+{
+    // Adds `p` to `out` unless `seen` has it. A begin assertion is passed
+    // through where the scan started at a text boundary and dies elsewhere.
+    template <typename List>
+    void enter(glushkov::automaton const& fa, unsigned p, bool at_begin, List& out, util::sparse_set& seen)
+    {
+        if (!seen.insert(p))
+            return;
+
+        if (fa.positions[p].kind == glushkov::symbol_kind::begin_assert)
+        {
+            if (at_begin)
+                for (auto q : fa.follow[p])
+                    enter(fa, q, at_begin, out, seen);
+            return;
+        }
+        out.push_back(p);
+    }
+
+    // Calls `reached(p)` for every '#' that `live` leads to through end
+    // assertions alone, i.e. that accepts if the text ends here. With
+    // `at_begin` (nothing read since the text started, as in `$^` on "")
+    // begin assertions are passed too. Entries that are no position
+    // (dfa.cpp's group separators) are skipped.
+    template <typename List, typename Reached>
+    void at_end(glushkov::automaton const& fa, List const& live, util::sparse_set& visited, bool at_begin, Reached reached)
+    {
+        visited.clear();
+        std::vector<unsigned> todo;
+        for (auto p : live)
+            if (static_cast<size_t>(p) < fa.positions.size() && fa.positions[p].kind == glushkov::symbol_kind::end_assert)
+                todo.push_back(p);
+
+        while (!todo.empty())
+        {
+            unsigned const p = todo.back();
+            todo.pop_back();
+            if (!visited.insert(p))
+                continue;
+
+            switch (fa.positions[p].kind)
+            {
+                case glushkov::symbol_kind::accept:
+                    reached(p);
+                    break;
+                case glushkov::symbol_kind::begin_assert:
+                    if (at_begin)
+                        todo.insert(todo.end(), fa.follow[p].begin(), fa.follow[p].end());
+                    break;
+                case glushkov::symbol_kind::end_assert:
+                    todo.insert(todo.end(), fa.follow[p].begin(), fa.follow[p].end());
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // States numbered in the order they turn up; `Key` tells them apart.
+    template <typename Key>
+    struct interner
+    {
+        std::map<Key, unsigned> ids;
+        std::vector<Key>        states;
+
+        // the id of `k`; if it is new, `added(k)` is called before it gets one
+        template <typename Added>
+        unsigned intern(Key k, Added added) {
+            auto found = ids.find(k);
+            if (found != ids.end())
+                return found->second;
+
+            added(k);
+            unsigned const id = states.size();
+            ids.emplace(k, id);
+            states.push_back(std::move(k));
+            return id;
+        }
+
+        // a state for `k` that no later `intern` maps to: the initial state
+        // at the text start when it accepts the empty text and a state with
+        // the same positions reached later must not
+        template <typename Added>
+        unsigned fresh(Key k, Added added) {
+            added(k);
+            states.push_back(std::move(k));
+            return states.size() - 1;
+        }
+    };
+
+    // a byte of every class, the one a class's transitions are computed for
+    inline std::vector<unsigned char> representatives(std::array<unsigned char, 256> const& classes, unsigned nclasses)
+    {
+        std::vector<unsigned char> out(nclasses);
+        for (unsigned b = 256; b-- > 0;)
+            out[classes[b]] = b;
+        return out;
+    }
+
+    // Appends the transitions of every state of `b` to `next`
+    // ([state * nclasses + class]) in id order; `b.transition(key, byte)`
+    // interns the states that turn up on the way. False once there are
+    // more than `max_states` states, unless that is 0.
+    template <typename Builder>
+    bool expand(Builder& b, std::array<unsigned char, 256> const& classes, unsigned nclasses, std::vector<unsigned>& next, unsigned max_states = 0)
+    {
+        auto const representative = representatives(classes, nclasses);
+        for (unsigned s = 0; s < b.states.size(); ++s)
+        {
+            if (max_states && b.states.size() > max_states)
+                return false;
+            auto const current = b.states[s]; // interning may move it
+            for (unsigned c = 0; c < nclasses; ++c)
+                next.push_back(b.transition(current, representative[c]));
+        }
+        return !max_states || b.states.size() <= max_states;
+    }
+
+    // For automata whose states are just the sets of live positions
+    // (lexer, ruleset). Every '#' belongs to a rule (`rule_of`, negative
+    // for other positions), and `Accept` folds the rules whose '#' is live
+    // into what a state reports:
+    //
+    //   using value = ...;
+    //   static value none();
+    //   static void  add(value&, unsigned rule);
+    //
+    // With `restart` every rule starts again before every byte, as in an
+    // unanchored search; without, a match starts where the scan does.
+    // State 0 is the empty set, i.e. dead.
+    template <typename Accept>
+    struct set_builder : interner<std::vector<unsigned>>
+    {
+        using items = std::vector<unsigned>; // sorted: only the set matters
+        using value = typename Accept::value;
+
+        glushkov::automaton const& fa;
+        std::vector<int> const&    rule_of;
+        bool const                 restart;
+        std::vector<value>         accepts;     // [state]: for a match ending before the next byte
+        std::vector<value>         eot_accepts; // [state]: the same if the text ends here
+        util::sparse_set           seen, visited;
+
+        set_builder(glushkov::automaton const& fa, std::vector<int> const& rule_of, bool restart)
+            : fa(fa), rule_of(rule_of), restart(restart), seen(fa.positions.size()), visited(fa.positions.size())
+        {
+            intern(items());
+        }
+
+        value accepted(items const& live) const {
+            value now = Accept::none();
+            for (auto p : live)
+                if (rule_of[p] >= 0)
+                    Accept::add(now, rule_of[p]);
+            return now;
+        }
+
+        value accepted_at_end(items const& live, bool at_begin) {
+            value later = accepted(live);
+            at_end(fa, live, visited, at_begin, [&](unsigned p) { Accept::add(later, rule_of[p]); });
+            return later;
+        }
+
+        unsigned intern(items list) {
+            std::sort(list.begin(), list.end());
+            return interner::intern(std::move(list), [&](items const& live) {
+                accepts.push_back(accepted(live));
+                eot_accepts.push_back(accepted_at_end(live, false));
+            });
+        }
+
+        unsigned initial(bool at_begin) {
+            items list;
+            seen.clear();
+            for (auto q : fa.first)
+                enter(fa, q, at_begin, list, seen);
+            std::sort(list.begin(), list.end());
+
+            if (at_begin)
+            {
+                value const empty_text = accepted_at_end(list, true);
+                if (empty_text != accepted_at_end(list, false))
+                    return fresh(std::move(list), [&](items const& live) {
+                        accepts.push_back(accepted(live));
+                        eot_accepts.push_back(empty_text);
+                    });
+            }
+            return intern(std::move(list));
+        }
+
+        unsigned transition(items const& from, unsigned char byte) {
+            items list;
+            seen.clear();
+            for (auto p : from)
+            {
+                auto const& pos = fa.positions[p];
+                if (pos.kind == glushkov::symbol_kind::byte && pos.chars.test(byte))
+                    for (auto q : fa.follow[p])
+                        enter(fa, q, false, list, seen);
+            }
+            if (restart)
+                for (auto q : fa.first)
+                    enter(fa, q, false, list, seen);
+            return intern(std::move(list));
+        }
+    };
+}
+
+#endif // __SUBSET__
@@ -0,0 +1,352 @@
+#include "tdfa.hpp"
+#include "sparse_set.hpp"
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace tdfa
+{
+    using glushkov::symbol_kind;
+
+    namespace
+    {
+        using items = std::vector<unsigned>;
+        using key   = std::pair<items, bool>; // (positions, restart)
+
+        // how an item of the next state came to be: from item `from` of the
+        // current state (-1 for a fresh thread), crossing the tags in `set`
+        struct origin
+        {
+            int                   from;
+            std::vector<unsigned> set;
+        };
+
+        struct subset_builder
+        {
+            glushkov::automaton const& fa;
+            unsigned const             tags;
+            automaton&                 out;
+
+            std::map<key, unsigned> ids;
+            std::vector<key>        states;
+            util::sparse_set        seen, visited;
+            std::vector<unsigned>   crossed; // tags on the path being entered
+
+            subset_builder(glushkov::automaton const& fa, unsigned tags, automaton& out)
+                : fa(fa), tags(tags), out(out), seen(fa.positions.size()), visited(fa.positions.size())
+            { }
+
+            // adds `p` unless already live; the first (highest priority)
+            // path to a position wins, as in a backtracking matcher. Tags
+            // are crossed on the way, begin assertions only at the boundary
+            void enter(unsigned p, bool at_begin, int from, items& list, std::vector<origin>& origins) {
+                if (!seen.insert(p))
+                    return;
+
+                switch (fa.positions[p].kind)
+                {
+                    case symbol_kind::begin_assert:
+                        if (at_begin)
+                            for (auto q : fa.follow[p])
+                                enter(q, at_begin, from, list, origins);
+                        return;
+
+                    case symbol_kind::tag:
+                        crossed.push_back(fa.positions[p].tag);
+                        for (auto q : fa.follow[p])
+                            enter(q, at_begin, from, list, origins);
+                        crossed.pop_back();
+                        return;
+
+                    default:
+                        list.push_back(p);
+                        origins.push_back({ from, crossed });
+                }
+            }
+
+            // the tags from `p` through pending end assertions to '#', in
+            // priority order; false if there is no such path. With
+            // `at_begin` (nothing read yet) begin assertions pass as well
+            bool reaches_accept_at_end(unsigned p, bool at_begin, std::vector<unsigned>& path) {
+                if (!visited.insert(p))
+                    return false;
+
+                switch (fa.positions[p].kind)
+                {
+                    case symbol_kind::accept:
+                        return true;
+                    case symbol_kind::begin_assert:
+                        if (!at_begin)
+                            return false;
+                        // fall through
+                    case symbol_kind::tag:
+                        if (fa.positions[p].kind == symbol_kind::tag)
+                            path.push_back(fa.positions[p].tag);
+                        // fall through
+                    case symbol_kind::end_assert:
+                        for (auto q : fa.follow[p])
+                            if (reaches_accept_at_end(q, at_begin, path))
+                                return true;
+                        if (fa.positions[p].kind == symbol_kind::tag)
+                            path.pop_back();
+                        return false;
+                    default:
+                        return false;
+                }
+            }
+
+            // the first item that accepts if the text ends here, and the
+            // tags set on the way; -1 if there is none
+            int eot_item(items const& list, bool at_begin, std::vector<unsigned>& path) {
+                for (unsigned i = 0; i < list.size(); ++i)
+                {
+                    path.clear();
+                    visited.clear();
+                    if (reaches_accept_at_end(list[i], at_begin, path))
+                        return i;
+                }
+                path.clear();
+                return -1;
+            }
+
+            // lower priority threads can no longer win once '#' is live
+            static void truncate(items& list, std::vector<origin>& origins, int accept) {
+                auto it = std::find(list.begin(), list.end(), unsigned(accept));
+                if (it == list.end())
+                    return;
+                size_t const keep = it - list.begin() + 1;
+                list.resize(keep);
+                origins.resize(keep);
+            }
+
+            // `at_begin` for a start state at the text start: if a begin
+            // assertion past an end assertion changes what it accepts at
+            // the end of the text (`$^` on ""), it is a state of its own
+            unsigned intern(items list, std::vector<origin>& origins, bool restart, bool at_begin = false) {
+                truncate(list, origins, fa.accept());
+                auto const accept = std::find(list.begin(), list.end(), fa.accept());
+                bool const accepting = accept != list.end();
+
+                key k(std::move(list), restart && !accepting);
+                std::vector<unsigned> path;
+                int eot = eot_item(k.first, false, path);
+                bool apart = false;
+                if (at_begin)
+                {
+                    std::vector<unsigned> first_path;
+                    int const first_eot = eot_item(k.first, true, first_path);
+                    apart = first_eot != eot || first_path != path;
+                    eot = first_eot;
+                    path.swap(first_path);
+                }
+
+                if (!apart)
+                {
+                    auto found = ids.find(k);
+                    if (found != ids.end())
+                        return found->second;
+                }
+
+                unsigned const id = states.size();
+                out.accept_item.push_back(accepting? int(accept - k.first.begin()) : -1);
+                out.eot_item.push_back(eot);
+                out.eot_tags.insert(out.eot_tags.end(), path.begin(), path.end());
+                out.eot_tags_begin.push_back(out.eot_tags.size());
+                out.registers = std::max<unsigned>(out.registers, k.first.size() * tags);
+                if (!apart)
+                    ids.emplace(k, id);
+                states.push_back(std::move(k));
+                return id;
+            }
+
+            // the register updates that move each origin into its item
+            void compile_ops(std::vector<origin> const& origins, std::vector<tag_op>& ops) const {
+                for (unsigned j = 0; j < origins.size(); ++j)
+                    for (unsigned t = 0; t < tags; ++t)
+                    {
+                        unsigned const dst = j * tags + t;
+                        auto const& set = origins[j].set;
+                        if (std::find(set.begin(), set.end(), t) != set.end())
+                            ops.push_back({ dst, tag_op::here });
+                        else if (origins[j].from < 0)
+                            ops.push_back({ dst, tag_op::clear });
+                        else if (unsigned(origins[j].from) * tags + t != dst)
+                            ops.push_back({ dst, int(origins[j].from * tags + t) });
+                    }
+            }
+
+            unsigned initial(bool at_begin, bool unanchored, std::vector<tag_op>& ops) {
+                items list;
+                std::vector<origin> origins;
+                seen.clear();
+                for (auto q : fa.first)
+                    enter(q, at_begin, -1, list, origins);
+                truncate(list, origins, fa.accept());
+                compile_ops(origins, ops);
+                return intern(std::move(list), origins, unanchored, at_begin);
+            }
+
+            unsigned transition(key const& from, unsigned char byte) {
+                items list;
+                std::vector<origin> origins;
+                seen.clear();
+                for (unsigned i = 0; i < from.first.size(); ++i)
+                {
+                    auto const& pos = fa.positions[from.first[i]];
+                    if (pos.kind == symbol_kind::byte && pos.chars.test(byte))
+                        for (auto q : fa.follow[from.first[i]])
+                            enter(q, false, i, list, origins);
+                }
+
+                if (from.second)
+                    for (auto q : fa.first)
+                        enter(q, false, -1, list, origins);
+
+                truncate(list, origins, fa.accept());
+                compile_ops(origins, out.ops);
+                out.ops_begin.push_back(out.ops.size());
+                return intern(std::move(list), origins, from.second);
+            }
+        };
+
+        // registers of the current thread set, and a scratch copy so the ops
+        // of one transition all read the old values
+        size_t const npos = size_t(-1); // an unset tag
+
+        struct register_file
+        {
+            std::vector<size_t> regs, scratch;
+
+            explicit register_file(unsigned size) : regs(size, npos), scratch(size) {}
+
+            void apply(tag_op const* first, tag_op const* last, size_t here) {
+                size_t* s = scratch.data();
+                for (auto op = first; op != last; ++op, ++s)
+                    *s = op->src >= 0? regs[op->src] : op->src == tag_op::here? here : npos;
+                s = scratch.data();
+                for (auto op = first; op != last; ++op, ++s)
+                    regs[op->dst] = *s;
+            }
+        };
+    }
+
+    automaton determinize(glushkov::automaton const& fa, unsigned tags, bool unanchored)
+    {
+        automaton out;
+        out.tags      = tags;
+        out.registers = 0;
+        out.nclasses  = dfa::byte_classes(fa, out.classes);
+
+        std::vector<unsigned char> representative(out.nclasses);
+        for (unsigned b = 256; b-- > 0;)
+            representative[out.classes[b]] = b;
+
+        subset_builder builder(fa, tags, out);
+        std::vector<origin> none;
+        out.eot_tags_begin.push_back(0);
+        builder.intern(items(), none, false); // automaton::dead
+        out.start[0] = builder.initial(true, unanchored, out.start_ops[0]);
+        out.start[1] = builder.initial(false, unanchored, out.start_ops[1]);
+
+        out.ops_begin.push_back(0);
+        for (unsigned s = 0; s < builder.states.size(); ++s)
+        {
+            key const current = builder.states[s];
+            for (unsigned c = 0; c < out.nclasses; ++c)
+                out.next.push_back(builder.transition(current, representative[c]));
+        }
+        return out;
+    }
+
+    matcher::matcher(ast::regex const& tree, bool icase)
+        : groups(glushkov::count_groups(tree)), locate(tree, dfa::match_kind::leftmost_first, icase)
+    {
+        stats::stopwatch timer;
+        glushkov::options opts;
+        opts.captures = true;
+        opts.icase    = icase;
+        auto const fa = glushkov::build(tree, opts);
+        compiled.time.positions = timer.lap();
+
+        anchored = determinize(fa, 2 * groups, false);
+        compiled.time.determinize = timer.lap();
+
+        compiled.positions   = fa.positions.size();
+        compiled.classes     = anchored.nclasses;
+        compiled.states      = anchored.size();
+        compiled.transitions = anchored.next.size();
+        compiled.table_bytes = anchored.next.size() * sizeof(anchored.next[0])
+                             + anchored.ops_begin.size() * sizeof(anchored.ops_begin[0])
+                             + anchored.ops.size() * sizeof(anchored.ops[0])
+                             + anchored.accept_item.size() * sizeof(int)
+                             + anchored.eot_item.size() * sizeof(int)
+                             + anchored.eot_tags_begin.size() * sizeof(unsigned)
+                             + anchored.eot_tags.size() * sizeof(unsigned)
+                             + sizeof(anchored.classes);
+    }
+
+    bool matcher::find(char const* begin, char const* end, char const* from, captures& out, stats::scan* counters) const
+    {
+        auto const found = locate.find(begin, end, from, counters);
+        if (!found)
+            return false;
+
+        automaton const& a = anchored;
+        register_file file(a.registers);
+        std::vector<size_t> best; // tags of the winning thread so far
+
+        auto take = [&](int item) {
+            best.assign(file.regs.begin() + item * a.tags, file.regs.begin() + (item + 1) * a.tags);
+        };
+
+        char const* const start = begin + found->begin;
+        int const at = start == begin? 0 : 1;
+        unsigned state = a.start[at];
+        file.apply(a.start_ops[at].data(), a.start_ops[at].data() + a.start_ops[at].size(), start - begin);
+
+        char const* p = start;
+        for (;; ++p)
+        {
+            if (p == end)
+            {
+                if (a.eot_item[state] >= 0)
+                {
+                    take(a.eot_item[state]);
+                    for (unsigned i = a.eot_tags_begin[state]; i < a.eot_tags_begin[state + 1]; ++i)
+                        best[a.eot_tags[i]] = p - begin;
+                }
+                break;
+            }
+            if (a.accept_item[state] >= 0)
+                take(a.accept_item[state]);
+
+            unsigned const t = state * a.nclasses + a.classes[static_cast<unsigned char>(*p)];
+            file.apply(a.ops.data() + a.ops_begin[t], a.ops.data() + a.ops_begin[t + 1], p + 1 - begin);
+            state = a.next[t];
+            if (state == automaton::dead)
+            {
+                ++p;
+                break;
+            }
+        }
+        if (counters)
+            counters->bytes += p - start;
+        if (best.empty()) // `locate` and the tagged automaton disagree
+            return false;
+
+        out.assign(groups, boost::none);
+        for (unsigned g = 0; g < groups; ++g)
+            if (best[2 * g] != npos && best[2 * g + 1] != npos)
+                out[g] = dfa::span { best[2 * g], best[2 * g + 1] };
+        return true;
+    }
+
+    boost::optional<captures> matcher::find(std::string const& text, size_t from, stats::scan* counters) const
+    {
+        captures out;
+        char const* begin = text.data();
+        if (!find(begin, begin + text.size(), begin + from, out, counters))
+            return boost::none;
+        return out;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef __TDFA__
+#define __TDFA__
+
+#include "ast.hpp"
+#include "dfa.hpp"
+#include "glushkov.hpp"
+#include "stats.hpp"
+#include <array>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace tdfa
+{
+    // group spans of one match; [0] is the whole match, unset groups are none
+    using captures = std::vector<boost::optional<dfa::span>>;
+
+    // One register update of a transition. All updates of a transition read
+    // the registers as they were before it (a parallel copy).
+    struct tag_op
+    {
+        static int const here  = -1; // the offset after the consumed byte
+        static int const clear = -2; // no offset
+
+        unsigned dst;
+        int      src; // a register, `here` or `clear`
+    };
+
+    // Subset construction over a glushkov automaton built with captures,
+    // leftmost-first (perl) semantics.
+    //
+    // A state is the priority-ordered list of live positions, exactly as in
+    // the plain DFA, so there are as many states. Item j of a state keeps
+    // the offsets of tag t in register j * tags + t; every transition
+    // carries the copies that move the surviving threads' tags into their
+    // new items, and stamps the tags crossed on the way. The copies leave
+    // out registers that stay in place, so a thread that keeps its slot
+    // costs nothing.
+    struct automaton
+    {
+        static unsigned const dead = 0;
+
+        unsigned                       tags;
+        unsigned                       registers;     // max items * tags
+        std::array<unsigned char, 256> classes;
+        unsigned                       nclasses;
+        std::vector<unsigned>          next;          // [state * nclasses + class]
+        std::vector<unsigned>          ops_begin;     // ops of transition i: [ops_begin[i], ops_begin[i+1])
+        std::vector<tag_op>            ops;
+
+        // the item holding '#' when a match ends before the next byte, or -1
+        std::vector<int>               accept_item;
+
+        // the item that wins if the text ends here, or -1, and the tags its
+        // path to '#' crosses (behind pending end assertions)
+        std::vector<int>               eot_item;
+        std::vector<unsigned>          eot_tags_begin;
+        std::vector<unsigned>          eot_tags;
+
+        unsigned                       start[2];      // as dfa::automaton::start
+        std::vector<tag_op>            start_ops[2];
+
+        unsigned size() const { return accept_item.size(); }
+    };
+
+    // `unanchored` starts a fresh lowest-priority thread at every byte until
+    // a match is seen.
+    automaton determinize(glushkov::automaton const& fa, unsigned tags, bool unanchored);
+
+    // Sub-match extraction. The plain DFA finds where the leftmost match
+    // starts, then the anchored tagged DFA runs once from there: the
+    // registers of the winning thread give every group boundary, so no
+    // thread set is ever simulated and no unanchored prefix pays for tags.
+    //
+    // Only the parenthesized groups capture; like perl, a group in a loop
+    // reports its last iteration. An empty iteration leaves its loop,
+    // ranked where the body ranks its empty match, in the plain DFA as
+    // well (glushkov::build): `(a*)*` on "aa" ends with an empty group 1,
+    // as in perl, and `(b*?)*` on "b" matches "".
+    struct matcher
+    {
+        unsigned       groups; // including group 0
+        dfa::matcher   locate;
+        automaton      anchored;
+        stats::compile compiled; // sizes of the tagged automaton
+
+        explicit matcher(ast::regex const& tree, bool icase = false);
+
+        bool find(char const* begin, char const* end, char const* from, captures& out, stats::scan* counters = nullptr) const;
+        boost::optional<captures> find(std::string const& text, size_t from = 0, stats::scan* counters = nullptr) const;
+    };
+}
+
+#endif // __TDFA__